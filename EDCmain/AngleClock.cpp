@@ -0,0 +1,110 @@
+#include "AngleClock.h"
+#include "RPMTimer.h"
+
+static volatile struct angleClockStruct {
+	unsigned int ticks; // timer timestamp of latest tooth
+	unsigned int angle; // angle of latest tooth
+	unsigned int span; // angle to next tooth
+	unsigned long period; // predicted ticks to next tooth
+	unsigned char valid;
+	unsigned char armed;
+	unsigned int target;
+	void (*handler)();
+} clk;
+
+// Arms compare C if target is within current tooth interval. Call with interrupts disabled.
+// late = run as soon as possible if target has already passed, otherwise wait for next revolution.
+static void angleClockArm(bool late) {
+	unsigned int delta = clk.target+(clk.target < clk.angle ? ANGLE_CLOCK_REVOLUTION : 0)-clk.angle;
+	if (delta >= clk.span)
+		return; // later tooth arms it
+	unsigned long ticks = (unsigned long)delta*clk.period/clk.span;
+	unsigned int elapsed = RPM_TCNT-clk.ticks;
+	if (ticks <= (unsigned long)elapsed+1) {
+		if (!late)
+			return;
+		ticks = elapsed+2;
+	}
+	RPM_OCRC = clk.ticks+(unsigned int)ticks;
+	RPM_TIFR = (1 << RPM_OCFC); // clear stale match
+	RPM_TIMSK |= (1 << RPM_OCIEC);
+	clk.armed = 1;
+}
+
+ISR(RPM_COMPC_vect)
+{
+	RPM_TIMSK &= ~(1 << RPM_OCIEC);
+	void (*handler)() = clk.handler;
+	clk.handler = 0;
+	clk.armed = 0;
+	if (handler)
+		handler();
+}
+
+void angleClockTooth(unsigned int ticks,unsigned int angle,unsigned int span,unsigned long period) {
+	clk.ticks = ticks;
+	clk.angle = angle;
+	clk.span = span;
+	clk.period = period;
+	clk.valid = 1;
+	if (clk.armed) {
+		// target was in previous interval but tooth came first, run now
+		RPM_OCRC = RPM_TCNT+2;
+		RPM_TIFR = (1 << RPM_OCFC);
+	} else if (clk.handler) {
+		angleClockArm(true);
+	}
+}
+
+void angleClockStop() {
+	clk.valid = 0;
+	if (clk.armed) {
+		// stays pending until angle is known again
+		RPM_TIMSK &= ~(1 << RPM_OCIEC);
+		clk.armed = 0;
+	}
+}
+
+int angleClockNow() {
+	cli();
+	if (!clk.valid) {
+		sei();
+		return -1;
+	}
+	unsigned int elapsed = RPM_TCNT-clk.ticks;
+	unsigned int angle = clk.angle;
+	unsigned int span = clk.span;
+	unsigned long period = clk.period;
+	sei();
+	if (elapsed >= period)
+		angle += span-1;
+	else
+		angle += (unsigned long)elapsed*span/period;
+	if (angle >= ANGLE_CLOCK_REVOLUTION)
+		angle -= ANGLE_CLOCK_REVOLUTION;
+	return angle;
+}
+
+bool angleClockSchedule(void (*handler)(),unsigned int angle) {
+	if (angle >= ANGLE_CLOCK_REVOLUTION)
+		return false;
+	cli();
+	if (clk.handler) {
+		sei();
+		return false;
+	}
+	clk.handler = handler;
+	clk.target = angle;
+	if (clk.valid)
+		angleClockArm(false);
+	sei();
+	return true;
+}
+
+void angleClockCancel() {
+	cli();
+	RPM_TIMSK &= ~(1 << RPM_OCIEC);
+	clk.handler = 0;
+	clk.armed = 0;
+	sei();
+}
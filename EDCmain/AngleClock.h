@@ -0,0 +1,31 @@
+#ifndef ANGLECLOCK_H
+#define ANGLECLOCK_H
+
+#include "Arduino.h"
+
+/*
+	Crank angle clock. Decoder feeds it on every accepted tooth/mark with the tooth angle and the
+	predicted timer ticks to the next tooth (latest tooth period). Current angle is extrapolated from
+	the latest tooth timestamp, never past the next tooth.
+
+	Angles are 0.1° units over one revolution (0..3599), 0 = reference tooth/mark of the decoder.
+	Decoder feeds the clock only when the reference is known (RPMDefaultCps: cylinder phase), until
+	then angleClockNow() returns -1 and callbacks stay pending.
+
+	One callback can be pending at a time. It is armed on RPM timer compare C when the target angle
+	is within the current tooth interval, so accuracy depends only on speed change during one tooth.
+	If the tooth comes before compare match (engine accelerating), callback runs immediately.
+	Callback runs in interrupt context with interrupts disabled, keep it short.
+*/
+
+#define ANGLE_CLOCK_REVOLUTION 3600
+
+// Decoder side, call from tooth interrupt (interrupts disabled)
+void angleClockTooth(unsigned int ticks,unsigned int angle,unsigned int span,unsigned long period);
+void angleClockStop(); // stall or sync lost
+
+int angleClockNow(); // -1 if angle is not known
+bool angleClockSchedule(void (*handler)(),unsigned int angle); // next time crank is at angle, false if one is pending
+void angleClockCancel();
+
+#endif
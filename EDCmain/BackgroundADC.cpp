@@ -1,4 +1,5 @@
 #include "BackgroundADC.h"
+#include "Trace.h"
 
 /*
 	Reads ADC value periodically in the background. Set ADC clock to slowest value (interrupt rate 9000hz),
@@ -20,6 +21,11 @@ ISR(ADC_vect) {
 	// set up for the next pin
 	adcPin++;
 	adcPin &= 0x0f;
+#ifdef TRACE
+	// every conversion would flood the ring, record full scans only
+	if (adcPin == 0)
+		TRACE_EVENT(TRACE_ADC,0);
+#endif
 
 	// the MUX5 bit of ADCSRB selects whether we're reading from channels
 	// 0 to 7 (MUX5 low) or 8 to 15 (MUX5 high).
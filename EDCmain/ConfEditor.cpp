@@ -3,6 +3,8 @@
 #include "utils.h"
 #include "Core.h"
 #include "DTC.h"
+#include "TaskStats.h"
+#include "UiSerial.h"
 
 ConfEditor confeditor;
 
@@ -20,11 +22,23 @@ const char confEditorMainScreen[][80] PROGMEM = {
 	"  <4> Output tests",
 	"  <5> Visualizer",	
 	"  <6> Boost Control Workbench",		
+#ifdef TASK_STATS
+	"  <7> Task timing",
+#endif
 	"  <.> Toggle status indicator (Status/RPM/TPS/Map)",    
 	" ",
 	"Send feedback to syncro16@outlook.com or visit http://dmn.kuulalaakeri.org/",
 	0};
 
+#ifdef TASK_STATS
+const char confEditorTaskStatsText[][80] PROGMEM = {
+	"Keys: r - reset statistics. Times in us, jitter = max. deviation of start interval",
+	// 01234567890123456789012345678901234567890123456789012345678901234567890123456789
+	"Task                    Rate Hz Calls   Min   Max   Mean  Jitter  Overruns",
+	"Memory: stack margin           bytes, heap           bytes, map arena",
+	0};
+#endif
+
 const char confEditorDTCText[][80] PROGMEM = {"Keys: r - reset fault memory, g - generate error","DTC Name","Count",0};
 
 const char confEditorAdaptationText[][80] PROGMEM = {
@@ -35,7 +49,11 @@ const char confEditorAdaptationText[][80] PROGMEM = {
 	0};
 
 const char confEditorMapCurrentOutput[] PROGMEM = "Current output (8bit / 10bit): ";
-const char confEditorMapEditorHelp[] PROGMEM = "Keys: -/+ adjust, </> change, c - copy, v - paste, s - save, <cursor keys> move";
+#ifdef MAP_HEATMAP
+const char confEditorMapEditorHelp[] PROGMEM = "Keys: -/+ adjust, x/X y/Y breakpoint, </> change, c/v copy/paste, m/M hits/clear, s - save";
+#else
+const char confEditorMapEditorHelp[] PROGMEM = "Keys: -/+ adjust, x/X y/Y breakpoint, </> change, c/v copy/paste, s - save";
+#endif
 const char confEditorMapCurrentMap[] PROGMEM = "Current map:";
 
 ConfEditor::ConfEditor() {
@@ -58,12 +76,12 @@ void ConfEditor::printHeader() {
 	ansiClearEol();
 	
 	row = fetchFromFlash(confEditorMainScreen[1+page])+6;
-	Serial.print(row);
+	uiSerial.print(row);
 	
 	row = fetchFromFlash(confEditorHeader[0]);
-	Serial.print(" (");
-	Serial.print(row);
-	Serial.print(")");
+	uiSerial.print(" (");
+	uiSerial.print(row);
+	uiSerial.print(")");
 
 	row = fetchFromFlash(confEditorHeader[1]);
 
@@ -72,22 +90,22 @@ void ConfEditor::printHeader() {
 			status = (char*)&systemStatusMessage;
 			break;
 		case 1:
-			itoa(core.controls[Core::valueEngineRPMFiltered],buf,10);
+			itoa(core.controlsSnapshot[Core::valueEngineRPMFiltered],buf,10);
 			memcpy(buf+strlen(buf)," RPM",5);
 			status = buf;
 			break;
 		case 2:
-			itoa(core.controls[Core::valueTPSActual],buf,10);
+			itoa(core.controlsSnapshot[Core::valueTPSActual],buf,10);
 			memcpy(buf+strlen(buf)," TPS",5);
 			status = buf;            break;
 		case 3:
-			itoa(core.controls[Core::valueBoostPressure],buf,10);
+			itoa(core.controlsSnapshot[Core::valueBoostPressure],buf,10);
 			memcpy(buf+strlen(buf)," kPa",5);
 			status = buf;            break;            
 	}
 	ansiGotoXy(80-strlen(row)-strlen(status),1);        
-	Serial.print(row);
-	Serial.print(status);
+	uiSerial.print(row);
+	uiSerial.print(status);
 }
 
 void ConfEditor::mainScreen() {
@@ -99,7 +117,7 @@ void ConfEditor::mainScreen() {
 	unsigned char mapIdx=0;
 	while ((row = fetchFromFlash(confEditorMainScreen[mapIdx]))) {
 		ansiGotoXy(1,mapIdx+3);
-		Serial.print(row);
+		uiSerial.print(row);
 		mapIdx++;
 	}
 }
@@ -161,21 +179,21 @@ void ConfEditor::pageOutputTests() {
 		ansiClearScreen();
 		printHeader();		
 		ansiGotoXy(1,5);
-		Serial.print(fetchFromFlash(confEditorOutputTestsGlow));
+		uiSerial.print(fetchFromFlash(confEditorOutputTestsGlow));
 		ansiGotoXy(35,5);
-		Serial.print(core.controls[Core::valueOutputGlow]?fetchFromFlash(confEditorOutputLabelOn):fetchFromFlash(confEditorOutputLabelOff));
+		uiSerial.print(core.controls[Core::valueOutputGlow]?fetchFromFlash(confEditorOutputLabelOn):fetchFromFlash(confEditorOutputLabelOff));
 		ansiGotoXy(1,6);
-		Serial.print(fetchFromFlash(confEditorOutputTestsFan));
+		uiSerial.print(fetchFromFlash(confEditorOutputTestsFan));
 		ansiGotoXy(35,6);
-		Serial.print(core.controls[Core::valueFan1State]?fetchFromFlash(confEditorOutputLabelOn):fetchFromFlash(confEditorOutputLabelOff));		
+		uiSerial.print(core.controls[Core::valueFan1State]?fetchFromFlash(confEditorOutputLabelOn):fetchFromFlash(confEditorOutputLabelOff));		
 		ansiGotoXy(1,7);
-		Serial.print(fetchFromFlash(confEditorOutputPumpAdvance));
+		uiSerial.print(fetchFromFlash(confEditorOutputPumpAdvance));
 		ansiGotoXy(35,7);
-		Serial.print(core.controls[Core::valueEngineTimingDutyCycle]);	
+		uiSerial.print(core.controls[Core::valueEngineTimingDutyCycle]);	
 		ansiGotoXy(1,8);
-		Serial.print(fetchFromFlash(confEditorOutputN75));
+		uiSerial.print(fetchFromFlash(confEditorOutputN75));
 		ansiGotoXy(35,8);
-		Serial.print(core.controls[Core::valueN75DutyCycle]);						
+		uiSerial.print(core.controls[Core::valueN75DutyCycle]);						
 	}
 }
 
@@ -210,129 +228,129 @@ void ConfEditor::pageVisualizer() {
 
 		buf=fetchFromFlash(confEditorVisualizerTPS);
 		ansiGotoXy(13,5);
-		Serial.print(buf+12);
+		uiSerial.print(buf+12);
 		ansiGotoXy(1,4);
 		buf[11] = 0;
-		Serial.print(buf);
+		uiSerial.print(buf);
 
 		buf=fetchFromFlash(confEditorVisualizerFuelAmount);
 		ansiGotoXy(13,5+2*1);
-		Serial.print(buf+12);
+		uiSerial.print(buf+12);
 		ansiGotoXy(1,4+2*1);
 		buf[11] = 0;
-		Serial.print(buf);
+		uiSerial.print(buf);
 
 
 		buf=fetchFromFlash(confEditorVisualizerQAFB);
 		ansiGotoXy(13,5+2*2);
-		Serial.print(buf+12);
+		uiSerial.print(buf+12);
 		ansiGotoXy(1,4+2*2);
 		buf[11] = 0;
-		Serial.print(buf);
+		uiSerial.print(buf);
 
 		buf=fetchFromFlash(confEditorVisualizerAdvance);
 		ansiGotoXy(13,5+2*3);
-		Serial.print(buf+12);
+		uiSerial.print(buf+12);
 		ansiGotoXy(1,4+2*3);
 		buf[11] = 0;
-		Serial.print(buf);
+		uiSerial.print(buf);
 
 		buf=fetchFromFlash(confEditorVisualizerN75);
 		ansiGotoXy(13,5+2*4);
-		Serial.print(buf+12);
+		uiSerial.print(buf+12);
 		ansiGotoXy(1,4+2*4);
 		buf[11] = 0;
-		Serial.print(buf);
+		uiSerial.print(buf);
 		
 		buf=fetchFromFlash(confEditorVisualizerMapActual);
 		ansiGotoXy(13,5+2*5);
-		Serial.print(buf+12);
+		uiSerial.print(buf+12);
 		ansiGotoXy(1,4+2*5);
 		buf[11] = 0;
-		Serial.print(buf);
+		uiSerial.print(buf);
 
 		buf=fetchFromFlash(confEditorVisualizerMapRequest);
 		ansiGotoXy(13,5+2*6);
-		Serial.print(buf+12);
+		uiSerial.print(buf+12);
 		ansiGotoXy(1,4+2*6);
 		buf[11] = 0;
-		Serial.print(buf);
+		uiSerial.print(buf);
 
 		buf=fetchFromFlash(confEditorVisualizerRPM);
 		ansiGotoXy(1,4+2*7);
-		Serial.print(buf);
+		uiSerial.print(buf);
 	}
-	if (core.controls[Core::valueTPSActual]/4 != oldTps) {
-		oldTps = core.controls[Core::valueTPSActual]/4;
+	if (core.controlsSnapshot[Core::valueTPSActual]/4 != oldTps) {
+		oldTps = core.controlsSnapshot[Core::valueTPSActual]/4;
 		ansiGotoXy(13,4+2*0);
 		for (char i=0;i<oldTps;i++)
-			Serial.print("*");
+			uiSerial.print("*");
 		ansiClearEol();
 	}
 
-	if (core.controls[Core::valueFuelAmount8bit]/4 != oldFuelAmount) {
-		oldFuelAmount = core.controls[Core::valueFuelAmount8bit]/4;
+	if (core.controlsSnapshot[Core::valueFuelAmount8bit]/4 != oldFuelAmount) {
+		oldFuelAmount = core.controlsSnapshot[Core::valueFuelAmount8bit]/4;
 		ansiGotoXy(13,4+2*1);
 		for (char i=0;i<oldFuelAmount;i++)
-			Serial.print("*");
+			uiSerial.print("*");
 		ansiClearEol();
 	}
 
-	if (core.controls[Core::valueQAfeedbackRaw]/16 != oldQAFB) {
-		oldQAFB = core.controls[Core::valueQAfeedbackRaw]/16;
+	if (core.controlsSnapshot[Core::valueQAfeedbackRaw]/16 != oldQAFB) {
+		oldQAFB = core.controlsSnapshot[Core::valueQAfeedbackRaw]/16;
 		ansiGotoXy(13,4+2*2);
 		for (char i=0;i<oldQAFB;i++)
-			Serial.print("*");
+			uiSerial.print("*");
 		ansiClearEol();	
 	}
 
-	if (core.controls[Core::valueEngineTimingDutyCycle]/4 != oldAdvance) {
-		oldAdvance = core.controls[Core::valueEngineTimingDutyCycle]/4;
+	if (core.controlsSnapshot[Core::valueEngineTimingDutyCycle]/4 != oldAdvance) {
+		oldAdvance = core.controlsSnapshot[Core::valueEngineTimingDutyCycle]/4;
 		ansiGotoXy(13,4+2*3);
 		for (char i=0;i<oldAdvance;i++)
-			Serial.print("*");
+			uiSerial.print("*");
 		ansiClearEol();
 	}
 
-	if (core.controls[Core::valueN75DutyCycle]/4 != oldN75) {
-		oldN75 = core.controls[Core::valueN75DutyCycle]/4;
+	if (core.controlsSnapshot[Core::valueN75DutyCycle]/4 != oldN75) {
+		oldN75 = core.controlsSnapshot[Core::valueN75DutyCycle]/4;
 		ansiGotoXy(13,4+2*4);
 		for (char i=0;i<oldN75;i++)
-			Serial.print("*");
+			uiSerial.print("*");
 		ansiClearEol();	
 	}	
 
 
-	if (core.controls[Core::valueBoostPressure]/4 != oldMap) {
-		oldMap = core.controls[Core::valueBoostPressure]/4;
+	if (core.controlsSnapshot[Core::valueBoostPressure]/4 != oldMap) {
+		oldMap = core.controlsSnapshot[Core::valueBoostPressure]/4;
 		ansiGotoXy(13,4+2*5);
 		for (char i=0;i<oldMap;i++)
-			Serial.print("*");
+			uiSerial.print("*");
 		ansiClearEol();	
 	}	
-	if (core.controls[Core::valueBoostTarget]/4 != oldMapRequest) {
-		oldMapRequest = core.controls[Core::valueBoostTarget]/4;
+	if (core.controlsSnapshot[Core::valueBoostTarget]/4 != oldMapRequest) {
+		oldMapRequest = core.controlsSnapshot[Core::valueBoostTarget]/4;
 		ansiGotoXy(13,4+2*6);
 		for (char i=0;i<oldMapRequest;i++)
-			Serial.print("*");
+			uiSerial.print("*");
 		ansiClearEol();	
 	}		
-	if ((core.controls[Core::valueEngineRPMFiltered]/10)*10 != oldRPM) {
-		oldRPM = (core.controls[Core::valueEngineRPMFiltered]/10)*10;
+	if ((core.controlsSnapshot[Core::valueEngineRPMFiltered]/10)*10 != oldRPM) {
+		oldRPM = (core.controlsSnapshot[Core::valueEngineRPMFiltered]/10)*10;
 		ansiGotoXy(13,4+2*7);
 		printIntWithPadding(oldRPM,5,' ');
 		ansiClearEol();
 	}
 	if (keyPressed == 'P') {
 		core.controls[Core::valueQADebug] = !core.controls[Core::valueQADebug];
-		if (core.controls[Core::valueQADebug]) Serial.println("QA Disabled");
+		if (core.controls[Core::valueQADebug]) uiSerial.println("QA Disabled");
 	}
 
 	ansiGotoXy(13,4+2*8);
-	if (core.controls[Core::valueBoostActuatorClipReason] == BOOST_MIN_CLIP) {
-		Serial.print("min clip");
-	} else 	if (core.controls[Core::valueBoostActuatorClipReason] == BOOST_MAX_CLIP) {
-		Serial.print("MAX clip");
+	if (core.controlsSnapshot[Core::valueBoostActuatorClipReason] == BOOST_MIN_CLIP) {
+		uiSerial.print("min clip");
+	} else 	if (core.controlsSnapshot[Core::valueBoostActuatorClipReason] == BOOST_MAX_CLIP) {
+		uiSerial.print("MAX clip");
 	} else {
 		ansiClearEol();
 	}
@@ -359,11 +377,11 @@ void ConfEditor::pageDTC() {
 		ansiGotoXy(1,3);
 		
 		row = fetchFromFlash(confEditorDTCText[0]);
-		Serial.println(row);
+		uiSerial.println(row);
 		
 		ansiGotoXy(1,5);
 		row = fetchFromFlash(confEditorDTCText[1]);
-		Serial.print(row);
+		uiSerial.print(row);
 		row = fetchFromFlash(confEditorDTCText[2]);
 		ansiGotoXy(60,5);
 		ansiGotoXy(1,6);
@@ -373,16 +391,77 @@ void ConfEditor::pageDTC() {
 		while (dtc.seekNextError()) {        
 			ansiGotoXy(3,y);
 			
-			Serial.print(dtc.getName());
+			uiSerial.print(dtc.getName());
 			ansiGotoXy(60,y);
 			
-			Serial.print(dtc.getCount());
+			uiSerial.print(dtc.getCount());
 			y++;
 		}
 
 	}    
 }
 
+#ifdef TASK_STATS
+void ConfEditor::pageTaskStats() {
+	if (keyPressed == 'r' || keyPressed == 'R')
+		taskStatsReset();
+	if (keyPressed == -1 && tick % 32 != 0)
+		return;
+
+	char *row;
+	taskStatsStruct stats;
+	ansiGotoXy(1,3);
+	row = fetchFromFlash(confEditorTaskStatsText[0]);
+	uiSerial.print(row);
+	ansiGotoXy(1,5);
+	row = fetchFromFlash(confEditorTaskStatsText[1]);
+	uiSerial.print(row);
+	ansiGotoXy(1,6);
+	printPads(77,'-');
+
+	for (unsigned char i=0;i<TASK_STATS_MAX;i++) {
+		taskStatsCopy(i,&stats);
+		ansiGotoXy(1,7+i);
+		ansiClearEol();
+		printFromFlash((const char*)pgm_read_word(&taskStatsNames[i]));
+		ansiGotoXy(25,7+i);
+		if (stats.period)
+			uiSerial.print(1000000L/stats.period);
+		else 
+			uiSerial.print("-");
+		ansiGotoXy(33,7+i);
+		uiSerial.print(stats.calls);
+		if (stats.calls) {
+			ansiGotoXy(41,7+i);
+			uiSerial.print(stats.minTime);
+			ansiGotoXy(47,7+i);
+			uiSerial.print(stats.maxTime);
+			ansiGotoXy(53,7+i);
+			uiSerial.print(stats.sumTime/stats.calls);
+			if (stats.period) {
+				ansiGotoXy(59,7+i);
+				uiSerial.print(stats.maxJitter);
+				ansiGotoXy(67,7+i);
+				uiSerial.print(stats.overruns);
+			}
+		}
+	}
+
+	unsigned char y = 8+TASK_STATS_MAX;
+	ansiGotoXy(1,y);
+	row = fetchFromFlash(confEditorTaskStatsText[2]);
+	uiSerial.print(row);
+	ansiGotoXy(26,y);
+	printIntWithPadding(core.controlsSnapshot[Core::valueStackMargin],5,' ');
+	ansiGotoXy(48,y);
+	printIntWithPadding(core.controlsSnapshot[Core::valueHeapUsed],5,' ');
+	ansiGotoXy(71,y);
+	uiSerial.print(core.mapArenaUsed);
+	uiSerial.print("/");
+	uiSerial.print(MAP_RAM_ARENA_SIZE);
+}
+#endif
+
 void ConfEditor::pageAdaptation() {
 	char *row;
 	bool redrawView = false;
@@ -452,7 +531,7 @@ void ConfEditor::pageAdaptation() {
 		ansiGotoXy(1,3);
 		
 		row = fetchFromFlash(confEditorAdaptationText[0]);
-		Serial.print(row);
+		uiSerial.print(row);
 		
 		ansiGotoXy(1,5);
 		printFromFlash(confEditorAdaptationText[1]);
@@ -461,9 +540,9 @@ void ConfEditor::pageAdaptation() {
 		printFromFlash(confEditorAdaptationText[2]);
 		
 		ansiGotoXy(24,5);
-		Serial.print(corePageNumber+1);
+		uiSerial.print(corePageNumber+1);
 		ansiGotoXy(26,5);
-		Serial.print((Core::NODE_MAX+rows-1)/rows);
+		uiSerial.print((Core::NODE_MAX+rows-1)/rows);
 		
 		for (i=0;i<rows;i++) {
 			int mapIdx = i+rows*corePageNumber;
@@ -474,10 +553,10 @@ void ConfEditor::pageAdaptation() {
                 if (item->properties) {   
 					ansiGotoXy(3,7+i);
 
-					// Serial.print(item->description);
+					// uiSerial.print(item->description);
 					printFromFlash(nodeDescription[mapIdx]);
 					if ((item->properties & NODE_PROPERTY_LOCKED) == NODE_PROPERTY_LOCKED) {
-						Serial.print(" (view only)");
+						uiSerial.print(" (view only)");
 					} 
 				}
 			}
@@ -498,14 +577,14 @@ void ConfEditor::pageAdaptation() {
 					
 					if (item->rawValueKey != Core::valueNone) {
 						ansiGotoXy(60,7+i);
-						//Serial.print(controls[item->rawValueKey]);
-						printValue(core.controls[item->rawValueKey],item->type);
+						//uiSerial.print(controls[item->rawValueKey]);
+						printValue(core.controlsSnapshot[item->rawValueKey],item->type);
 					}
 					
 					if (item->actualValueKey != Core::valueNone) {
 						ansiGotoXy(70,7+i);
-						//Serial.print(controls[item->actualValueKey]);
-						printValue(core.controls[item->actualValueKey],VALUE_PERCENTAGE);
+						//uiSerial.print(controls[item->actualValueKey]);
+						printValue(core.controlsSnapshot[item->actualValueKey],VALUE_PERCENTAGE);
 					}
 					
 				}
@@ -516,20 +595,20 @@ void ConfEditor::pageAdaptation() {
 		
 		if (activeRow != activeRowOld) {
 			ansiGotoXy(1,7+activeRowOld);
-			Serial.print("  ");
+			uiSerial.print("  ");
 			ansiGotoXy(50-2,7+activeRowOld);
-			Serial.print(" ");
+			uiSerial.print(" ");
 			ansiGotoXy(58,7+activeRowOld);
-			Serial.print(" ");
+			uiSerial.print(" ");
 			activeRowOld = activeRow;
 			
 		}
 		ansiGotoXy(1,7+activeRow);
-		Serial.print(">>");
+		uiSerial.print(">>");
 		ansiGotoXy(50-2,7+activeRow);
-		Serial.print(">");
+		uiSerial.print(">");
 		ansiGotoXy(58,7+activeRow);
-		Serial.print("<");
+		uiSerial.print("<");
 	}
 	
 }
@@ -540,19 +619,24 @@ void ConfEditor::pageMapEditor(bool compactMode = false) {
 	bool redrawView = false;
 	// unsigned char *mapData = editorMaps[mapIdx];
 	//unsigned char *mapData = core.boostMap;
-	unsigned char *mapData = core.maps[mapIdx]+2; // 2 skip file_id offset
-
-	unsigned char tableSizeX = *(mapData+3);
-	unsigned char tableSizeY = *(mapData+4);
-	unsigned char axisTypeX = *(mapData+5);
-	unsigned char axisTypeY = *(mapData+6);
-	unsigned char axisTypeResult = *(mapData+7);
-	unsigned char lastXpos = *(mapData+8+tableSizeX*tableSizeY);
-	unsigned char lastYpos = *(mapData+8+tableSizeX*tableSizeY+1);
-	unsigned char lastValue = *(mapData+8+tableSizeX*tableSizeY+2);
-	unsigned int lastValue10b = *(unsigned int*)(mapData+8+tableSizeX*tableSizeY+3);
-	unsigned char idxX = *(mapData+8+tableSizeX*tableSizeY+5);
-	unsigned char idxY = *(mapData+8+tableSizeX*tableSizeY+6);
+	mapInfoStruct *map = &core.mapInfo[mapIdx];
+
+	watchMap(mapIdx);
+
+	unsigned char tableSizeX = map->sizeX;
+	unsigned char tableSizeY = map->sizeY;
+	unsigned char axisTypeX = mapDataByte(map,MAP_OFS_AXIS_TYPE_X);
+	unsigned char axisTypeY = mapDataByte(map,MAP_OFS_AXIS_TYPE_Y);
+	unsigned char axisTypeResult = mapDataByte(map,MAP_OFS_AXIS_TYPE_RESULT);
+	cli();
+	mapTelemetryStruct telemetry = mapTelemetry;
+	sei();
+	unsigned char lastXpos = telemetry.lastX;
+	unsigned char lastYpos = telemetry.lastY;
+	unsigned int lastValue10b = map->wide ? telemetry.lastRet : (telemetry.lastRet+32)>>6;
+	unsigned char lastValue = map->wide ? (lastValue10b>1021 ? 255 : (lastValue10b+2)>>2) : (telemetry.lastRet+128)>>8;
+	unsigned char idxX = telemetry.idxX;
+	unsigned char idxY = telemetry.idxY;
 
 	const char xPad = 5;
 	char xSpace ;
@@ -569,58 +653,104 @@ void ConfEditor::pageMapEditor(bool compactMode = false) {
 	
 	switch (keyPressed) {
 		case 'c':
-			mapEditorData.clipboard = *(mapData+8+mapEditorData.cursorX+mapEditorData.cursorY*tableSizeX);
+			mapEditorData.clipboard = getMapCell(mapEditorData.cursorX,mapEditorData.cursorY);
 			break;
 		case 'v':
-			(*(mapData+8+mapEditorData.cursorX+mapEditorData.cursorY*tableSizeX)) = mapEditorData.clipboard;
+			setMapCell(mapEditorData.cursorX,mapEditorData.cursorY,mapEditorData.clipboard);
 			updateCell = true;
 			break;
 		case 'h':
 			ansiGotoXy(xPad+xSpace+mapEditorData.cursorX*xSpace,yPad+ySpace+mapEditorData.cursorY*ySpace);
-			Serial.print(" ");
+			uiSerial.print(" ");
 			ansiGotoXy(xPad+xSpace+mapEditorData.cursorX*xSpace+xSpace,yPad+ySpace+mapEditorData.cursorY*ySpace);
-			Serial.print(" ");  
+			uiSerial.print(" ");  
 			if (mapEditorData.cursorX>0)
 				mapEditorData.cursorX--;
 			updateCursor = true;
 			break;
 		case 'l':
 			ansiGotoXy(xPad+xSpace+mapEditorData.cursorX*xSpace,yPad+ySpace+mapEditorData.cursorY*ySpace);
-			Serial.print(" ");
+			uiSerial.print(" ");
 			ansiGotoXy(xPad+xSpace+mapEditorData.cursorX*xSpace+xSpace,yPad+ySpace+mapEditorData.cursorY*ySpace);
-			Serial.print(" "); 
+			uiSerial.print(" "); 
 			if (mapEditorData.cursorX<tableSizeX-1)
 				mapEditorData.cursorX++;
 			updateCursor = true;
 			break;
 		case 'k':
 			ansiGotoXy(xPad+xSpace+mapEditorData.cursorX*xSpace,yPad+ySpace+mapEditorData.cursorY*ySpace);
-			Serial.print(" ");
+			uiSerial.print(" ");
 			ansiGotoXy(xPad+xSpace+mapEditorData.cursorX*xSpace+xSpace,yPad+ySpace+mapEditorData.cursorY*ySpace);
-			Serial.print(" ");  
+			uiSerial.print(" ");  
 			if (mapEditorData.cursorY>0)
 				mapEditorData.cursorY--;
 			updateCursor = true;
 			break;
 		case 'j':
 			ansiGotoXy(xPad+xSpace+mapEditorData.cursorX*xSpace,yPad+ySpace+mapEditorData.cursorY*ySpace);
-			Serial.print(" ");
+			uiSerial.print(" ");
 			ansiGotoXy(xPad+xSpace+mapEditorData.cursorX*xSpace+xSpace,yPad+ySpace+mapEditorData.cursorY*ySpace);
-			Serial.print(" ");  
+			uiSerial.print(" ");  
 			if (mapEditorData.cursorY<tableSizeY-1)
 				mapEditorData.cursorY++;
 			updateCursor = true;
 			break;
 		case '+':
-			if (*(mapData+8+mapEditorData.cursorX+mapEditorData.cursorY*tableSizeX)<0xff)
-				(*(mapData+8+mapEditorData.cursorX+mapEditorData.cursorY*tableSizeX))++;
+			if (getMapCell(mapEditorData.cursorX,mapEditorData.cursorY)<(map->wide ? MAP_WIDE_CELL_MAX : 0xff))
+				setMapCell(mapEditorData.cursorX,mapEditorData.cursorY,getMapCell(mapEditorData.cursorX,mapEditorData.cursorY)+1);
 			updateCell = true;            
 			break;
 		case '-':
-			if (*(mapData+8+mapEditorData.cursorX+mapEditorData.cursorY*tableSizeX)>0)
-				(*(mapData+8+mapEditorData.cursorX+mapEditorData.cursorY*tableSizeX))--;
+			if (getMapCell(mapEditorData.cursorX,mapEditorData.cursorY)>0)
+				setMapCell(mapEditorData.cursorX,mapEditorData.cursorY,getMapCell(mapEditorData.cursorX,mapEditorData.cursorY)-1);
 			updateCell = true;            
 			break;
+		case 'x':
+		case 'X':
+		case 'y':
+		case 'Y':
+			// move breakpoint of current column/row, keep breakpoints in increasing order 
+			if (map->axisX) {
+				unsigned char *data = core.beginMapEdit(mapIdx);
+				unsigned char *axis;
+				unsigned char size,pos;
+				if (!data)
+					break;
+				if (keyPressed == 'x' || keyPressed == 'X') {
+					axis = data+(map->axisX-map->data);
+					size = tableSizeX;
+					pos = mapEditorData.cursorX;
+				} else {
+					axis = data+(map->axisY-map->data);
+					size = tableSizeY;
+					pos = mapEditorData.cursorY;
+				}
+				if (keyPressed == 'x' || keyPressed == 'y') {
+					if (*(axis+pos) > 0 && (pos == 0 || *(axis+pos)-1 > *(axis+pos-1)))
+						(*(axis+pos))--;
+				} else {
+					if (*(axis+pos) < 0xff && (pos == size-1 || *(axis+pos)+1 < *(axis+pos+1)))
+						(*(axis+pos))++;
+				}
+				core.commitMapEdit(mapIdx);
+				core.groupMaps();
+				redrawView = true;
+				updateCursor = true;
+			}
+			break;
+#ifdef MAP_HEATMAP
+		case 'm':
+			// toggle between cell values and hit counters
+			mapEditorData.showHeatmap = !mapEditorData.showHeatmap;
+			redrawView = true;
+			updateCursor = true;
+			break;
+		case 'M':
+			core.clearHeatmap(mapIdx);
+			redrawView = true;
+			updateCursor = true;
+			break;
+#endif
 		case 's':
 			core.save();
 			break;
@@ -654,13 +784,13 @@ void ConfEditor::pageMapEditor(bool compactMode = false) {
 		
 		ansiGotoXy(0,5);
 		printFromFlash(confEditorMapCurrentMap);
-		Serial.print(core.mapNames[mapIdx]);
+		printFromFlash(core.mapNames[mapIdx]);
 		
 		// Table X header
 		
 		for (int x=0;x<tableSizeX;x++) {
 			ansiGotoXy(xPad+(1+x)*xSpace,yPad);
-			int mapIdx = round((float)((255/(float)(tableSizeX-1)))*(float)x);
+			int mapIdx = map->axisX ? mapDataByte(map,map->axisX-map->data+x) : round((float)((255/(float)(tableSizeX-1)))*(float)x);
 			printPads(1,' ');
 			printMapAxis(axisTypeX,mapIdx, ((x==0||x==(tableSizeX-1))?true:false));
 		}
@@ -671,14 +801,14 @@ void ConfEditor::pageMapEditor(bool compactMode = false) {
 		
 		for (int y=0;y<tableSizeY;y++) {
 			ansiGotoXy(xPad-1,yPad+(1+y)*ySpace);
-			int mapIdx = round((float)((255/(float)(tableSizeY-1)))*(float)y);
+			int mapIdx = map->axisY ? mapDataByte(map,map->axisY-map->data+y) : round((float)((255/(float)(tableSizeY-1)))*(float)y);
 			
 			printMapAxis(axisTypeY,mapIdx,true);
 			ansiGotoXy(xPad+xSpace-1,yPad+(1+y)*ySpace);
-			Serial.print("|");
+			uiSerial.print("|");
 			if (y<tableSizeY-1) {
 				ansiGotoXy(xPad+xSpace-1,yPad+(1+y)*ySpace+1); // works for ySpace=2
-				Serial.print("|");
+				uiSerial.print("|");
 			}
 			
 		}
@@ -686,58 +816,81 @@ void ConfEditor::pageMapEditor(bool compactMode = false) {
 			for (int x=0;x<tableSizeX;x++) {
 				ansiGotoXy(xPad+(1+x)*xSpace,yPad+(1+y)*ySpace);
 				printPads(1,' ');
-				//Serial.print(*(mapData+8+x*y),DEC);
-				printMapAxis(axisTypeResult,*(mapData+8+x+y*tableSizeX),0);
+				printMapCell(x,y);
 			}
 		}
 	}
 	
+#ifdef MAP_HEATMAP
+	// hit counters change all the time
+	if (mapEditorData.showHeatmap && !redrawView && tick % 32 == 0) {
+		for (int y=0;y<tableSizeY;y++) {
+			for (int x=0;x<tableSizeX;x++) {
+				ansiGotoXy(xPad+(1+x)*xSpace+1,yPad+(1+y)*ySpace);
+				printPads(xSpace-2,' ');
+				ansiGotoXy(xPad+(1+x)*xSpace+1,yPad+(1+y)*ySpace);
+				printMapCell(x,y);
+			}
+		}
+	}
+#endif
+
 	if (updateCell) {
 		ansiGotoXy(xPad+xSpace+mapEditorData.cursorX*xSpace+1,yPad+ySpace+mapEditorData.cursorY*ySpace);
 		printPads(xSpace-2,' ');
 		ansiGotoXy(xPad+xSpace+mapEditorData.cursorX*xSpace+1,yPad+ySpace+mapEditorData.cursorY*ySpace);
-		printMapAxis(axisTypeResult,*(mapData+8+mapEditorData.cursorX+mapEditorData.cursorY*tableSizeX),0);
+		printMapCell(mapEditorData.cursorX,mapEditorData.cursorY);
 	}
 
 	if (updateCursor) {
 		ansiGotoXy(xPad+xSpace+mapEditorData.cursorX*xSpace,yPad+ySpace+mapEditorData.cursorY*ySpace);
-		Serial.print(">");
+		uiSerial.print(">");
 		ansiGotoXy(xPad+xSpace+mapEditorData.cursorX*xSpace+xSpace,yPad+ySpace+mapEditorData.cursorY*ySpace);
-		Serial.print("<");  
+		uiSerial.print("<");  
 	}
 
 	// table live view (last queried X, Y and returned interpolated value (8bit or 10bit interpolated value)
 	if (tick % 4 == 0) {
 		ansiGotoXy(3,yPad);
-		Serial.print("(");
-		Serial.print(idxX);
-		Serial.print(",");
-		Serial.print(idxY);
-		Serial.print(")");
-
-		ansiGotoXy(2,yPad+ySpace+round((float)mapEditorData.lastY*(float)((float)(tableSizeY-1)*(float)ySpace/255)));
-		Serial.print("  ");
-		ansiGotoXy(xPad+xSpace+round((float)mapEditorData.lastX*(float)((float)tableSizeX*(float)xSpace/255)),yPad-1);
-		Serial.print(" ");
+		uiSerial.print("(");
+		uiSerial.print(idxX);
+		uiSerial.print(",");
+		uiSerial.print(idxY);
+		uiSerial.print(")");
+
+		// marker screen positions, maps with breakpoints show nearest cell
+		unsigned char markerX,markerY;
+		if (map->axisX) {
+			markerX = xPad+xSpace+(idxX-1)*xSpace+xSpace/2;
+			markerY = yPad+ySpace+(idxY-1)*ySpace;
+		} else {
+			markerX = xPad+xSpace+round((float)lastXpos*(float)((float)tableSizeX*(float)xSpace/255));
+			markerY = yPad+ySpace+round((float)lastYpos*(float)((float)(tableSizeY-1)*(float)ySpace/255));
+		}
+
+		ansiGotoXy(2,mapEditorData.lastY);
+		uiSerial.print("  ");
+		ansiGotoXy(mapEditorData.lastX,yPad-1);
+		uiSerial.print(" ");
 		
-		mapEditorData.lastY = lastYpos;
-		mapEditorData.lastX = lastXpos;
+		mapEditorData.lastY = markerY;
+		mapEditorData.lastX = markerX;
 		
-		ansiGotoXy(2,yPad+ySpace+round((float)lastYpos*(float)((float)(tableSizeY-1)*(float)ySpace/255)));
-		Serial.print(">>");
-		ansiGotoXy(xPad+xSpace+round((float)lastXpos*(float)((float)tableSizeX*(float)xSpace/255)),yPad-1);
-		Serial.print("v"); 
+		ansiGotoXy(2,markerY);
+		uiSerial.print(">>");
+		ansiGotoXy(markerX,yPad-1);
+		uiSerial.print("v"); 
 
 		if (!compactMode) {
 			ansiGotoXy(xPad+xSpace,yPad+tableSizeY*ySpace+2);
 			printFromFlash(confEditorMapCurrentOutput);
 			printMapAxis(axisTypeResult,lastValue,1);
-			Serial.print(" / ");
-			Serial.print(lastValue10b);
-		/*	Serial.print("\t X:");
-			Serial.print(idxX,DEC);		
-			Serial.print("\t Y:");
-			Serial.print(idxY,DEC);	*/	
+			uiSerial.print(" / ");
+			uiSerial.print(lastValue10b);
+		/*	uiSerial.print("\t X:");
+			uiSerial.print(idxX,DEC);		
+			uiSerial.print("\t Y:");
+			uiSerial.print(idxY,DEC);	*/	
 			ansiClearEol();
 		}
 		
@@ -745,6 +898,63 @@ void ConfEditor::pageMapEditor(bool compactMode = false) {
 
 }
 
+// Cell value of current map ('W' maps have 16-bit cells)
+unsigned int ConfEditor::getMapCell(unsigned char x,unsigned char y) {
+	mapInfoStruct *map = &core.mapInfo[mapIdx];
+	unsigned int ofs = map->cells-map->data;
+	unsigned char idx = x+y*map->sizeX;
+	if (map->wide)
+		return mapDataByte(map,ofs+idx*2)+(mapDataByte(map,ofs+idx*2+1)<<8);
+	return mapDataByte(map,ofs+idx);
+}
+
+void ConfEditor::setMapCell(unsigned char x,unsigned char y,unsigned int value) {
+	mapInfoStruct *map = &core.mapInfo[mapIdx];
+	unsigned char *data = core.beginMapEdit(mapIdx);
+	if (!data)
+		return;
+	unsigned char *cells = data+(map->cells-map->data);
+	unsigned char idx = x+y*map->sizeX;
+	if (map->wide)
+		*((unsigned int*)cells+idx) = value;
+	else
+		*(cells+idx) = value>0xff ? 0xff : value;
+	core.commitMapEdit(mapIdx);
+}
+
+void ConfEditor::printMapCell(unsigned char x,unsigned char y) {
+#ifdef MAP_HEATMAP
+	mapInfoStruct *map = &core.mapInfo[mapIdx];
+	if (mapEditorData.showHeatmap) {
+		if (map->heat)
+			uiSerial.print(*(map->heat+x+y*map->sizeX),DEC);
+		else
+			uiSerial.print("-");
+		return;
+	}
+#endif
+	if (core.mapInfo[mapIdx].wide) {
+		// wide cells are shown as is (10-bit output units)
+		uiSerial.print(getMapCell(x,y),DEC);
+	} else {
+		printMapAxis(mapDataByte(&core.mapInfo[mapIdx],MAP_OFS_AXIS_TYPE_RESULT),getMapCell(x,y),0);
+	}
+}
+
+// Attach live view telemetry record to given map (detached from all maps if idx is -1)
+void ConfEditor::watchMap(char idx) {
+	for (unsigned char i=0;i<core.numberOfMaps;i++) {
+		mapTelemetryStruct *telemetry = (i == idx) ? &mapTelemetry : NULL;
+		if (core.mapInfo[i].telemetry != telemetry) {
+			if (telemetry)
+				memset(&mapTelemetry,0,sizeof(mapTelemetry));
+			cli();
+			core.mapInfo[i].telemetry = telemetry;
+			sei();
+		}
+	}
+}
+
 void ConfEditor::setSystemStatusMessage(const char *msg) {
 	statusPrinted = false;
 	if (strlen(msg) >= sizeof(systemStatusMessage)) {
@@ -770,6 +980,8 @@ void ConfEditor::handleInput(char node) {
 		toggleStatus();
 	if (node>='0' && node<='9') {
 		page = node-'0';
+		// map pages attach live view again on their next refresh
+		watchMap(-1);
 		ansiClearScreen();
 		tick = 0;
 		statusPrinted = false;
@@ -779,8 +991,13 @@ void ConfEditor::handleInput(char node) {
 void ConfEditor::refresh() {
 	if (!uiEnabled)
 		return;
+	core.takeControlsSnapshot();
 	
+#ifdef TASK_STATS
+	if (page>7)
+#else
 	if (page>6)
+#endif
 		page = 0;
 	
 	if (!statusPrinted/* || statusIndex != 0*/) {
@@ -817,6 +1034,12 @@ void ConfEditor::refresh() {
 			core.controls[Core::valueOutputTestMode] = false;		
 			pageBoostWorkBench();
 			break;									
+#ifdef TASK_STATS
+		case 7:
+			core.controls[Core::valueOutputTestMode] = false;		
+			pageTaskStats();
+			break;
+#endif
 	}
 	keyPressed = -1;
 	tick++;
@@ -934,104 +1157,104 @@ void ConfEditor::pageBoostWorkBench() {
 	}
 	
 	static int pp,ii,dd;
-	if (redrawView || pp != core.controls[Core::valueBoostPIDComponentP]) {
-		pp = core.controls[Core::valueBoostPIDComponentP];
+	if (redrawView || pp != core.controlsSnapshot[Core::valueBoostPIDComponentP]) {
+		pp = core.controlsSnapshot[Core::valueBoostPIDComponentP];
 		ansiGotoXy(14,22);
 		printIntWithPadding(pp,4,' ');
 	}
-	if (redrawView || ii != core.controls[Core::valueBoostPIDComponentI]) {
-		ii = core.controls[Core::valueBoostPIDComponentI];
+	if (redrawView || ii != core.controlsSnapshot[Core::valueBoostPIDComponentI]) {
+		ii = core.controlsSnapshot[Core::valueBoostPIDComponentI];
 		ansiGotoXy(24,22);
 		printIntWithPadding(ii,4,' ');
 	}
-	if (redrawView || dd != core.controls[Core::valueBoostPIDComponentD]) {
-		dd = core.controls[Core::valueBoostPIDComponentD];
+	if (redrawView || dd != core.controlsSnapshot[Core::valueBoostPIDComponentD]) {
+		dd = core.controlsSnapshot[Core::valueBoostPIDComponentD];
 		ansiGotoXy(34,22);
 		printIntWithPadding(dd,4,' ');
 	}
 
 	static unsigned char oldBVDC;
-	if (redrawView || core.controls[Core::valueBoostValveDutyCycle]/4 != oldBVDC) {
-		oldBVDC = core.controls[Core::valueBoostValveDutyCycle]/4;
+	if (redrawView || core.controlsSnapshot[Core::valueBoostValveDutyCycle]/4 != oldBVDC) {
+		oldBVDC = core.controlsSnapshot[Core::valueBoostValveDutyCycle]/4;
 		ansiGotoXy(11,25);
 		for (char i=0;i<oldBVDC;i++)
-			Serial.print("*");
+			uiSerial.print("*");
 		ansiClearEol();
 		ansiGotoXy(76,25);
-		printIntWithPadding(core.controls[Core::valueBoostValveDutyCycle],4,' ');	
+		printIntWithPadding(core.controlsSnapshot[Core::valueBoostValveDutyCycle],4,' ');	
 	}
 
 	static int oldPid;
-	if (redrawView || core.controls[Core::valueBoostPIDCorrection] /4 != oldPid) {
-		oldPid = core.controls[Core::valueBoostPIDCorrection] /4 ;
+	if (redrawView || core.controlsSnapshot[Core::valueBoostPIDCorrection] /4 != oldPid) {
+		oldPid = core.controlsSnapshot[Core::valueBoostPIDCorrection] /4 ;
 		ansiGotoXy(11,26);
 		ansiClearEol();	
 		
 		if (oldPid<0) {
 			ansiGotoXy(11+32+oldPid,26);
 			for (char i=0;i<(-oldPid);i++)
-				Serial.print("-");
+				uiSerial.print("-");
 		} else {
 			ansiGotoXy(11+32,26);			
 			for (char i=0;i<oldPid;i++)
-				Serial.print("+");
+				uiSerial.print("+");
 		}
 		ansiGotoXy(76,25);
-		printIntWithPadding(core.controls[Core::valueBoostPIDCorrection],4,' ');
+		printIntWithPadding(core.controlsSnapshot[Core::valueBoostPIDCorrection],4,' ');
 	}
 
 	static unsigned char oldBCA;
-	if (redrawView || core.controls[Core::valueBoostCalculatedAmount]/4 != oldBCA) {
-		oldBCA = core.controls[Core::valueBoostCalculatedAmount]/4;
+	if (redrawView || core.controlsSnapshot[Core::valueBoostCalculatedAmount]/4 != oldBCA) {
+		oldBCA = core.controlsSnapshot[Core::valueBoostCalculatedAmount]/4;
 		ansiGotoXy(11,27);
 		for (unsigned char i=0;i<oldBCA;i++)
-			Serial.print("=");
+			uiSerial.print("=");
 		ansiClearEol();
 		ansiGotoXy(76,27);
-		printIntWithPadding(core.controls[Core::valueBoostCalculatedAmount],4,' ');	
+		printIntWithPadding(core.controlsSnapshot[Core::valueBoostCalculatedAmount],4,' ');	
 	}
 
 	static unsigned char oldMap;
-	if (redrawView || core.controls[Core::valueBoostPressure]/4 != oldMap) {
-		oldMap = core.controls[Core::valueBoostPressure]/4;
+	if (redrawView || core.controlsSnapshot[Core::valueBoostPressure]/4 != oldMap) {
+		oldMap = core.controlsSnapshot[Core::valueBoostPressure]/4;
 		ansiGotoXy(11,28);
 		for (char i=0;i<oldMap;i++)
-			Serial.print("M");
+			uiSerial.print("M");
 		ansiClearEol();
 		ansiGotoXy(76,28);	
-		printIntWithPadding(toKpa(core.controls[Core::valueBoostPressure]),3,' ');			
+		printIntWithPadding(toKpa(core.controlsSnapshot[Core::valueBoostPressure]),3,' ');			
 	}
 
 	static unsigned char oldMapSetpoint;
-	if (redrawView || core.controls[Core::valueBoostTarget]/4 != oldMapSetpoint) {
-		oldMapSetpoint = core.controls[Core::valueBoostTarget]/4;
+	if (redrawView || core.controlsSnapshot[Core::valueBoostTarget]/4 != oldMapSetpoint) {
+		oldMapSetpoint = core.controlsSnapshot[Core::valueBoostTarget]/4;
 		ansiGotoXy(11,29);
 		for (char i=0;i<oldMapSetpoint;i++)
-			Serial.print("S");
+			uiSerial.print("S");
 		ansiClearEol();
 		ansiGotoXy(76,29);	
-		printIntWithPadding(toKpa(core.controls[Core::valueBoostTarget]),3,' ');				
+		printIntWithPadding(toKpa(core.controlsSnapshot[Core::valueBoostTarget]),3,' ');				
 	}
 
 	static unsigned int oldRPM;
-	if (redrawView || (core.controls[Core::valueEngineRPM]/10)*10 != oldRPM) {
-		oldRPM = (core.controls[Core::valueEngineRPM]/10)*10;
+	if (redrawView || (core.controlsSnapshot[Core::valueEngineRPM]/10)*10 != oldRPM) {
+		oldRPM = (core.controlsSnapshot[Core::valueEngineRPM]/10)*10;
 		ansiGotoXy(11,30);
 		printIntWithPadding(oldRPM,5,' ');
 		ansiClearEol();
 	}
 
 	static unsigned char oldIq;
-	if (redrawView || core.controls[Core::valueFuelAmount8bit] != oldIq) {
-		oldIq = core.controls[Core::valueFuelAmount8bit];
+	if (redrawView || core.controlsSnapshot[Core::valueFuelAmount8bit] != oldIq) {
+		oldIq = core.controlsSnapshot[Core::valueFuelAmount8bit];
 		ansiGotoXy(11,31);
 		printIntWithPadding(oldIq,5,' ');
 		ansiClearEol();
 	}
 
 	static unsigned char oldDc;
-	if (redrawView || core.controls[Core::valueN75DutyCycle] != oldDc) {
-		oldDc = core.controls[Core::valueN75DutyCycle];
+	if (redrawView || core.controlsSnapshot[Core::valueN75DutyCycle] != oldDc) {
+		oldDc = core.controlsSnapshot[Core::valueN75DutyCycle];
 		ansiGotoXy(11,32);
 		printIntWithPadding(oldDc,5,' ');
 		ansiClearEol();
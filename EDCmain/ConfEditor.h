@@ -20,13 +20,17 @@ private:
     struct mapEditorDataStruct {
         char cursorX,cursorXold;
         char cursorY,cursorYold;
-        unsigned char lastX;
+        unsigned char lastX; // live view marker screen position
         unsigned char lastY;
         char currentMap;
-        unsigned char clipboard;
+        unsigned int clipboard;
+#ifdef MAP_HEATMAP
+        bool showHeatmap; // cells show hit counters instead of values
+#endif
     } mapEditorData;
 
     unsigned char mapIdx;
+    mapTelemetryStruct mapTelemetry;
 public:
     bool liveMode;
     bool uiEnabled;
@@ -40,6 +44,13 @@ private:
     void pageOutputTests();
     void pageVisualizer();
     void pageBoostWorkBench();
+#ifdef TASK_STATS
+    void pageTaskStats();
+#endif
+    void watchMap(char idx);
+    unsigned int getMapCell(unsigned char x,unsigned char y);
+    void setMapCell(unsigned char x,unsigned char y,unsigned int value);
+    void printMapCell(unsigned char x,unsigned char y);
     
 public:
     ConfEditor();
@@ -218,91 +218,110 @@ Core::Core() {
 
 	// (file_id in EEPROM, initial_value, min, max, increment_step, bindedRawValue, bindedActualValue,isLocked?,description of this value (max 45 chars!))
 
-	/* MAP header <map-id>, 0xf0, .... 
+	/* MAP header <map-id>, 0xf0, 'M', <dimensions '1'/'2'>, <format>, sizeX, sizeY, axisTypeX, axisTypeY, axisTypeResult 
+	Header is generated from map type (see Map.h), MAP_CHECK fails compile if cell count does not match the type
 	Map id is used for saving/loading maps from eeprom, use unique id
+	Format 'D' = interpolated, breakpoints evenly distributed over 0..255 
+	Format 'B' = interpolated, header is followed by sizeX+sizeY explicit axis breakpoints (increasing values)
+	Format 'W' = as 'B', but cells are 16-bit words (MAP_WORD) in 10-bit output units (0..MAP_WIDE_CELL_MAX)
 	*/ 
    
 	/* 0xf? Fuel injections maps */
 	/* basic injection amount */
 
-	static unsigned char fuelMap[] = {
-	  0xF0,0xF0,'M','2','D',
-	  0x8,0x6,MAP_AXIS_RPM,MAP_AXIS_TPS,MAP_AXIS_INJECTED_FUEL,
- 		100,	70,     35,     0,      0,      0,      0,      0,
-		100,    100,    78,    37,     0,      0,      0,      0,
-	    100,    100,    80,    75,    37,     10,      0,      0,
-	    100,    100,    100,    100,    60,    77,     10,     0,
-        100,    100,    100,    100,    100,    100,    77,     0,
-        100,    100,    100,    100,    100,    100,    100,    0,      
-		0,0,0,0,0,1,1                // lastX,lastY,lastRet,lastRet 10bit (2 bytes),idxX,idxY
-	 };
+	typedef Map<8,6,MAP_AXIS_RPM,MAP_AXIS_TPS,MAP_AXIS_INJECTED_FUEL,'W'> fuelMapType;
+	static const unsigned char fuelMap[] PROGMEM = {
+		MAP_HEADER(0xF0,fuelMapType),
+		0,36,73,109,146,182,219,255,	// rpm breakpoints
+		0,51,102,153,204,255,			// tps breakpoints
+		MAP_WORD(400),MAP_WORD(280),MAP_WORD(140),MAP_WORD(0),MAP_WORD(0),MAP_WORD(0),MAP_WORD(0),MAP_WORD(0),
+		MAP_WORD(400),MAP_WORD(400),MAP_WORD(312),MAP_WORD(148),MAP_WORD(0),MAP_WORD(0),MAP_WORD(0),MAP_WORD(0),
+		MAP_WORD(400),MAP_WORD(400),MAP_WORD(320),MAP_WORD(300),MAP_WORD(148),MAP_WORD(40),MAP_WORD(0),MAP_WORD(0),
+		MAP_WORD(400),MAP_WORD(400),MAP_WORD(400),MAP_WORD(400),MAP_WORD(240),MAP_WORD(308),MAP_WORD(40),MAP_WORD(0),
+		MAP_WORD(400),MAP_WORD(400),MAP_WORD(400),MAP_WORD(400),MAP_WORD(400),MAP_WORD(400),MAP_WORD(308),MAP_WORD(0),
+		MAP_WORD(400),MAP_WORD(400),MAP_WORD(400),MAP_WORD(400),MAP_WORD(400),MAP_WORD(400),MAP_WORD(400),MAP_WORD(0),
+		MAP_TRAILER
+	};
+	MAP_CHECK(fuelMap,fuelMapType);
 
 	/* additive (injection) fuel map for boost */
 
-	static unsigned char boostMap[] = {
-	  0xF1,0xF0,'M','2','D',
-	  0x8,0x6,MAP_AXIS_RPM,MAP_AXIS_KPA,MAP_AXIS_INJECTED_FUEL,
-	  0,0,0,0,     0,0,0,0,
-	  31,31,31,31, 31,31,31,0,
-	  53,47,65,65, 75,75,75,0,
-	  30,30,78,78, 85,85,85,0,	  
-	  0,0,0,0, 0,0,0,0,
-	  0,0,0,0, 0,0,0,0,
-		0,0,0,0,0,1,1                // lastX,lastY,lastRet,lastRet 10bit (2 bytes),idxX,idxY
+	typedef Map<8,6,MAP_AXIS_RPM,MAP_AXIS_KPA,MAP_AXIS_INJECTED_FUEL,'W'> boostMapType;
+	static const unsigned char boostMap[] PROGMEM = {
+		MAP_HEADER(0xF1,boostMapType),
+		0,36,73,109,146,182,219,255,	// rpm breakpoints
+		0,51,102,153,204,255,			// boost pressure breakpoints
+		MAP_WORD(0),MAP_WORD(0),MAP_WORD(0),MAP_WORD(0),MAP_WORD(0),MAP_WORD(0),MAP_WORD(0),MAP_WORD(0),
+		MAP_WORD(124),MAP_WORD(124),MAP_WORD(124),MAP_WORD(124),MAP_WORD(124),MAP_WORD(124),MAP_WORD(124),MAP_WORD(0),
+		MAP_WORD(212),MAP_WORD(188),MAP_WORD(260),MAP_WORD(260),MAP_WORD(300),MAP_WORD(300),MAP_WORD(300),MAP_WORD(0),
+		MAP_WORD(120),MAP_WORD(120),MAP_WORD(312),MAP_WORD(312),MAP_WORD(340),MAP_WORD(340),MAP_WORD(340),MAP_WORD(0),
+		MAP_WORD(0),MAP_WORD(0),MAP_WORD(0),MAP_WORD(0),MAP_WORD(0),MAP_WORD(0),MAP_WORD(0),MAP_WORD(0),
+		MAP_WORD(0),MAP_WORD(0),MAP_WORD(0),MAP_WORD(0),MAP_WORD(0),MAP_WORD(0),MAP_WORD(0),MAP_WORD(0),
+		MAP_TRAILER
 	};
+	MAP_CHECK(boostMap,boostMapType);
 
 	/* Cold Start & idle fuel map */
-	static unsigned char idleMap[] = {
-		0xF2,0xF0,'M','2','D',
-		0x8,0x4,MAP_AXIS_IDLERPM,MAP_AXIS_CELSIUS,MAP_AXIS_INJECTED_FUEL,
-		255,255,255,114, 80,60,60,50,
-		190,130,90,80, 70,60,50,40,		
-		190,120,90,80, 70,60,50,40,
-		190,110,90,80, 70,60,50,40,
-		0,0,0,0,0,1,1                // lastX,lastY,lastRet,lastRet 10bit (2 bytes),idxX,idxY
+	typedef Map<8,4,MAP_AXIS_IDLERPM,MAP_AXIS_CELSIUS,MAP_AXIS_INJECTED_FUEL,'W'> idleMapType;
+	static const unsigned char idleMap[] PROGMEM = {
+		MAP_HEADER(0xF2,idleMapType),
+		0,36,73,109,146,182,219,255,	// rpm breakpoints
+		0,85,170,255,					// temperature breakpoints
+		MAP_WORD(1020),MAP_WORD(1020),MAP_WORD(1020),MAP_WORD(456),MAP_WORD(320),MAP_WORD(240),MAP_WORD(240),MAP_WORD(200),
+		MAP_WORD(760),MAP_WORD(520),MAP_WORD(360),MAP_WORD(320),MAP_WORD(280),MAP_WORD(240),MAP_WORD(200),MAP_WORD(160),
+		MAP_WORD(760),MAP_WORD(480),MAP_WORD(360),MAP_WORD(320),MAP_WORD(280),MAP_WORD(240),MAP_WORD(200),MAP_WORD(160),
+		MAP_WORD(760),MAP_WORD(440),MAP_WORD(360),MAP_WORD(320),MAP_WORD(280),MAP_WORD(240),MAP_WORD(200),MAP_WORD(160),
+		MAP_TRAILER
 	};
-
-	static unsigned char coastMap[] = {
-		0xF5,0xF0,'M','1','D',
-		0x8,0x1,MAP_AXIS_RPM,MAP_AXIS_NONE,MAP_AXIS_INJECTED_FUEL,
-		100,100,50,10, 0,0,0,0,
-		0,0,0,0,0,1,1                // lastX,lastY,lastRet,lastRet 10bit (2 bytes),idxX,idxY
+	MAP_CHECK(idleMap,idleMapType);
+
+	typedef Map<8,1,MAP_AXIS_RPM,MAP_AXIS_NONE,MAP_AXIS_INJECTED_FUEL,'W'> coastMapType;
+	static const unsigned char coastMap[] PROGMEM = {
+		MAP_HEADER(0xF5,coastMapType),
+		0,36,73,109,146,182,219,255,	// rpm breakpoints
+		0,								// no y axis
+		MAP_WORD(400),MAP_WORD(400),MAP_WORD(200),MAP_WORD(40),MAP_WORD(0),MAP_WORD(0),MAP_WORD(0),MAP_WORD(0),
+		MAP_TRAILER
 	};
+	MAP_CHECK(coastMap,coastMapType);
 
-	static unsigned char fuelTrimFuelTemp[] = {
-		0xF3,0xF0,'M','1','D',
-		0x8,0x1,MAP_AXIS_CELSIUS,MAP_AXIS_NONE,MAP_AXIS_FUEL_TRIM_AMOUNT,
+	typedef Map<8,1,MAP_AXIS_CELSIUS,MAP_AXIS_NONE,MAP_AXIS_FUEL_TRIM_AMOUNT,'D'> fuelTrimFuelTempType;
+	static const unsigned char fuelTrimFuelTemp[] PROGMEM = {
+		MAP_HEADER(0xF3,fuelTrimFuelTempType),
 		128,128,128,128,128,128,128,128,
-		0,0,0,0,0,1,1                // lastX,lastY,lastRet,lastRet 10bit (2 bytes),idxX,idxY
+		MAP_TRAILER
 	};
+	MAP_CHECK(fuelTrimFuelTemp,fuelTrimFuelTempType);
 	
-	static unsigned char fuelTrimAirTemp[] = {
-		0xF4,0xF0,'M','1','D',
-		0x8,0x1,MAP_AXIS_CELSIUS,MAP_AXIS_NONE,MAP_AXIS_FUEL_TRIM_AMOUNT,
+	typedef Map<8,1,MAP_AXIS_CELSIUS,MAP_AXIS_NONE,MAP_AXIS_FUEL_TRIM_AMOUNT,'D'> fuelTrimAirTempType;
+	static const unsigned char fuelTrimAirTemp[] PROGMEM = {
+		MAP_HEADER(0xF4,fuelTrimAirTempType),
 		128,128,128,128,128,128,128,128,
-		0,0,0,0,0,1,1                // lastX,lastY,lastRet,lastRet 10bit (2 bytes),idxX,idxY
+		MAP_TRAILER
 	};
+	MAP_CHECK(fuelTrimAirTemp,fuelTrimAirTempType);
 
 	/* 0xe? engine timing */
 	/*  static mode */
 
-	static unsigned char openLoopAdvanceMap[] = {
-		0xe0,0xF0,'M','2','D',
-		0x6,0x6,MAP_AXIS_RPM,MAP_AXIS_INJECTED_FUEL,MAP_AXIS_DUTY_CYCLE,
+	typedef Map<6,6,MAP_AXIS_RPM,MAP_AXIS_INJECTED_FUEL,MAP_AXIS_DUTY_CYCLE,'D'> openLoopAdvanceMapType;
+	static const unsigned char openLoopAdvanceMap[] PROGMEM = {
+		MAP_HEADER(0xe0,openLoopAdvanceMapType),
 		255,255,255, 255,255,255, 
 		255,255,255, 255,255,210, 
 		255,255,255, 255,180,180, 
 		255,255,255,    190,140,0, 
 		255,255,255,    100,80,0, 
 		100,100,100,    50,50,0, 
-		0,0,0,0,0,1,1                // lastX,lastY,lastRet,lastRet 10bit (2 bytes),idxX,idxY
+		MAP_TRAILER
 	};
+	MAP_CHECK(openLoopAdvanceMap,openLoopAdvanceMapType);
 
 	/* dynamic mode */
 
-	static unsigned char closedLoopAdvanceMap[] = {
-		0xe1,0xF0,'M','2','D',
-		0x6,0x6,MAP_AXIS_RPM,MAP_AXIS_INJECTED_FUEL,MAP_AXIS_INJECTION_TIMING,
+	typedef Map<6,6,MAP_AXIS_RPM,MAP_AXIS_INJECTED_FUEL,MAP_AXIS_INJECTION_TIMING,'D'> closedLoopAdvanceMapType;
+	static const unsigned char closedLoopAdvanceMap[] PROGMEM = {
+		MAP_HEADER(0xe1,closedLoopAdvanceMapType),
 		0,0,0, 0,0,0, 
 		0,0,0, 0,0,0, 
 		0,0,0, 0,0,0,  
@@ -310,110 +329,291 @@ Core::Core() {
 		0,0,0, 0,0,0, 
 		0,0,0, 0,0,0, 
 		0,0,0, 0,0,0,  
-		0,0,0,0,0,1,1                // lastX,lastY,lastRet,lastRet 10bit (2 bytes),idxX,idxY
+		MAP_TRAILER
 	};
+	MAP_CHECK(closedLoopAdvanceMap,closedLoopAdvanceMapType);
 
 
 	/*  0xd? - Turbo wastegate / VNT control maps */
 
 	/* basic duty cycle vs rpm*injection amount */
 
-	static unsigned char turboControlMap[] = {
-		0xd0,0xF0,'M','2','D',
-		0x6,0x6,MAP_AXIS_RPM,MAP_AXIS_INJECTED_FUEL,MAP_AXIS_DUTY_CYCLE,
+	typedef Map<6,6,MAP_AXIS_RPM,MAP_AXIS_INJECTED_FUEL,MAP_AXIS_DUTY_CYCLE,'D'> turboControlMapType;
+	static const unsigned char turboControlMap[] PROGMEM = {
+		MAP_HEADER(0xd0,turboControlMapType),
 		201,227,210,201,171,158,
 		201,227,208,192,169,158,	
 		201,182,198,180,162,158,
 		201,201,195,166,153,140,
 		201,182,118,151,151,28,
 		201,182,156,103,59,28,		
-		0,0,0,0,0,1,1                // lastX,lastY,lastRet,lastRet 10bit (2 bytes),idxX,idxY
+		MAP_TRAILER
 	};
+	MAP_CHECK(turboControlMap,turboControlMapType);
 
 	/* target pressure map */
-	static unsigned char turboTargetPressureMap[] = {
-		0xd1,0xF0,'M','2','D',
-		0x6,0x4,MAP_AXIS_RPM,MAP_AXIS_TPS,MAP_AXIS_KPA,
+	typedef Map<6,4,MAP_AXIS_RPM,MAP_AXIS_TPS,MAP_AXIS_KPA,'D'> turboTargetPressureMapType;
+	static const unsigned char turboTargetPressureMap[] PROGMEM = {
+		MAP_HEADER(0xd1,turboTargetPressureMapType),
 		0,0,0,0,0,0,
 		0,0,0,10,20,100,	
 		0,0,10,30,100,128,
 		100,100,100,100,100,100,
-		0,0,0,0,0,1,1                // lastX,lastY,lastRet,lastRet 10bit (2 bytes),idxX,idxY
+		MAP_TRAILER
 	};
+	MAP_CHECK(turboTargetPressureMap,turboTargetPressureMapType);
 
 	/* actuator opening/operating curve */
-	static unsigned char actuatorTension[] = {
-		0xd2,0xF0,'M','1','D',
-		0x8,0x1,MAP_AXIS_RAW,MAP_AXIS_NONE,MAP_AXIS_RAW,
+	typedef Map<8,1,MAP_AXIS_RAW,MAP_AXIS_NONE,MAP_AXIS_RAW,'D'> actuatorTensionType;
+	static const unsigned char actuatorTension[] PROGMEM = {
+		MAP_HEADER(0xd2,actuatorTensionType),
 		255,215,192,143,90,55,23,0,
-		0,0,0,0,0,1,1                // lastX,lastY,lastRet,lastRet 10bit (2 bytes),idxX,idxY
-	};			
+		MAP_TRAILER
+	};
+	MAP_CHECK(actuatorTension,actuatorTensionType);			
 
 	/* 0xc? - temperature related maps */
 
-	static unsigned char glowPeriodMap[] = {
-		0xc4,0xF0,'M','1','D',
-		0x8,0x1,MAP_AXIS_CELSIUS,MAP_AXIS_NONE,MAP_AXIS_HALF_SECONDS,
+	typedef Map<8,1,MAP_AXIS_CELSIUS,MAP_AXIS_NONE,MAP_AXIS_HALF_SECONDS,'D'> glowPeriodMapType;
+	static const unsigned char glowPeriodMap[] PROGMEM = {
+		MAP_HEADER(0xc4,glowPeriodMapType),
 		40,22,8,6,3,0,0,0,
-		0,0,0,0,0,1,1                // lastX,lastY,lastRet,lastRet 10bit (2 bytes),idxX,idxY
+		MAP_TRAILER
 	};
+	MAP_CHECK(glowPeriodMap,glowPeriodMapType);
 
-	static unsigned char tempSenderMap[] = {
-		0xc5,0xF0,'M','1','D',
-		0x8,0x1,MAP_AXIS_CELSIUS,MAP_AXIS_NONE,MAP_AXIS_RAW,
+	typedef Map<8,1,MAP_AXIS_CELSIUS,MAP_AXIS_NONE,MAP_AXIS_RAW,'D'> tempSenderMapType;
+	static const unsigned char tempSenderMap[] PROGMEM = {
+		MAP_HEADER(0xc5,tempSenderMapType),
 		0,0,18,66,130,170,255,255,
-		0,0,0,0,0,1,1                // lastX,lastY,lastRet,lastRet 10bit (2 bytes),idxX,idxY
+		MAP_TRAILER
 	};
+	MAP_CHECK(tempSenderMap,tempSenderMapType);
 	
 
 	/* 0xb? - temperature sensor calibration maps */
 
 	/* 0x7? Generic control maps */
 
-	static unsigned char idlePidP[] = {
-		0x70,0xF0,'M','1','D',
-		10,0x1,MAP_AXIS_IDLERPM,MAP_AXIS_NONE,MAP_AXIS_RAW,
+	typedef Map<10,1,MAP_AXIS_IDLERPM,MAP_AXIS_NONE,MAP_AXIS_RAW,'D'> idlePidPType;
+	static const unsigned char idlePidP[] PROGMEM = {
+		MAP_HEADER(0x70,idlePidPType),
 		12,12,10,6,4, 2,2,2,5,10,
-		0,0,0,0,0,1,1                // lastX,lastY,lastRet,lastRet 10bit (2 bytes),idxX,idxY
-	};		
-
-	mapNames[Core::mapIdxFuelMap] = "Basic Injection Map";
-	mapNames[Core::mapIdxBoostMap] = "Additive Injection Map (Boost)";
-	mapNames[Core::mapIdxIdleMap] = "Injection quantity when starting / idling";
-	mapNames[Core::mapIdxOpenLoopAdvanceMap] = "Open Loop advance";
-	mapNames[Core::mapIdxClosedLoopAdvanceMap] = "Closed Loop advance";
-	mapNames[Core::mapIdxTurboControlMap] = "Turbo actuator; duty cycle base map";
-	mapNames[Core::mapIdxTurboTargetPressureMap] = "Turbo actuator; target pressure";
-	mapNames[Core::mapIdxGlowPeriodMap] = "Glow period (half seconds)";
-	mapNames[Core::mapIdxtempSenderMap] = "Temp Sender emu. output";
-
-
-	mapNames[Core::mapIdxFuelTrimFuelTemp] = "Fuel Trim amount vs. Fuel Temp.";
-	mapNames[Core::mapIdxFuelTrimAirTemp] = "Fuel Trim amount vs. Air Temp.";
-	mapNames[Core::mapIdxActuatorTension] = "Turbo Actuator Operating Curve";
-	mapNames[Core::mapIdxIdlePidP] = "Idle PID P-parameter during idle";
-	mapNames[Core::mapIdxCoastingFuelLimit] = "Fuel limit during coasting";
-
-
-	maps[Core::mapIdxFuelMap] = (unsigned char*)&fuelMap;
-	maps[Core::mapIdxIdleMap] = (unsigned char*)&idleMap;
-	maps[Core::mapIdxBoostMap] = (unsigned char*)&boostMap;
-	maps[Core::mapIdxOpenLoopAdvanceMap] = (unsigned char*)&openLoopAdvanceMap;
-	maps[Core::mapIdxClosedLoopAdvanceMap] = (unsigned char*)&closedLoopAdvanceMap;
-	maps[Core::mapIdxTurboControlMap] = (unsigned char*)&turboControlMap;
-	maps[Core::mapIdxTurboTargetPressureMap] = (unsigned char*)&turboTargetPressureMap;
-	maps[Core::mapIdxGlowPeriodMap] = (unsigned char*)&glowPeriodMap;
-	maps[Core::mapIdxtempSenderMap] = (unsigned char*)&tempSenderMap;
-
-
-//	maps[Core::mapIdxFuelTrimMap] = (unsigned char*)&fuelTrimMap;
-	maps[Core::mapIdxFuelTrimFuelTemp] = (unsigned char*)&fuelTrimFuelTemp;
-	maps[Core::mapIdxFuelTrimAirTemp] = (unsigned char*)&fuelTrimAirTemp;
-	maps[Core::mapIdxActuatorTension] = (unsigned char*)&actuatorTension;
-	maps[Core::mapIdxIdlePidP] = (unsigned char*)&idlePidP;
-	maps[Core::mapIdxCoastingFuelLimit] = (unsigned char*)&coastMap;
+		MAP_TRAILER
+	};
+	MAP_CHECK(idlePidP,idlePidPType);		
+
+	// arena holds the edit copy (shadow) and the usually tuned fuel maps, maps equal to default stay in
+	// flash. Other maps get RAM while space lasts, otherwise they keep the flash default (DTC 21)
+	typedef MapSet<fuelMapType,boostMapType,idleMapType,coastMapType,fuelTrimFuelTempType,fuelTrimAirTempType,
+		openLoopAdvanceMapType,closedLoopAdvanceMapType,turboControlMapType,turboTargetPressureMapType,
+		actuatorTensionType,glowPeriodMapType,tempSenderMapType,idlePidPType> allMaps;
+	typedef MapSet<fuelMapType,boostMapType,idleMapType> tunedMaps;
+	static_assert(allMaps::largest+tunedMaps::size <= MAP_RAM_ARENA_SIZE,"MAP_RAM_ARENA_SIZE too small for fuel maps and an edit copy");
+
+	mapNames[Core::mapIdxFuelMap] = PSTR("Basic Injection Map");
+	mapNames[Core::mapIdxBoostMap] = PSTR("Additive Injection Map (Boost)");
+	mapNames[Core::mapIdxIdleMap] = PSTR("Injection quantity when starting / idling");
+	mapNames[Core::mapIdxOpenLoopAdvanceMap] = PSTR("Open Loop advance");
+	mapNames[Core::mapIdxClosedLoopAdvanceMap] = PSTR("Closed Loop advance");
+	mapNames[Core::mapIdxTurboControlMap] = PSTR("Turbo actuator; duty cycle base map");
+	mapNames[Core::mapIdxTurboTargetPressureMap] = PSTR("Turbo actuator; target pressure");
+	mapNames[Core::mapIdxGlowPeriodMap] = PSTR("Glow period (half seconds)");
+	mapNames[Core::mapIdxtempSenderMap] = PSTR("Temp Sender emu. output");
+
+
+	mapNames[Core::mapIdxFuelTrimFuelTemp] = PSTR("Fuel Trim amount vs. Fuel Temp.");
+	mapNames[Core::mapIdxFuelTrimAirTemp] = PSTR("Fuel Trim amount vs. Air Temp.");
+	mapNames[Core::mapIdxActuatorTension] = PSTR("Turbo Actuator Operating Curve");
+	mapNames[Core::mapIdxIdlePidP] = PSTR("Idle PID P-parameter during idle");
+	mapNames[Core::mapIdxCoastingFuelLimit] = PSTR("Fuel limit during coasting");
+
+
+	maps[Core::mapIdxFuelMap] = fuelMap;
+	maps[Core::mapIdxIdleMap] = idleMap;
+	maps[Core::mapIdxBoostMap] = boostMap;
+	maps[Core::mapIdxOpenLoopAdvanceMap] = openLoopAdvanceMap;
+	maps[Core::mapIdxClosedLoopAdvanceMap] = closedLoopAdvanceMap;
+	maps[Core::mapIdxTurboControlMap] = turboControlMap;
+	maps[Core::mapIdxTurboTargetPressureMap] = turboTargetPressureMap;
+	maps[Core::mapIdxGlowPeriodMap] = glowPeriodMap;
+	maps[Core::mapIdxtempSenderMap] = tempSenderMap;
+
+
+//	maps[Core::mapIdxFuelTrimMap] = fuelTrimMap;
+	maps[Core::mapIdxFuelTrimFuelTemp] = fuelTrimFuelTemp;
+	maps[Core::mapIdxFuelTrimAirTemp] = fuelTrimAirTemp;
+	maps[Core::mapIdxActuatorTension] = actuatorTension;
+	maps[Core::mapIdxIdlePidP] = idlePidP;
+	maps[Core::mapIdxCoastingFuelLimit] = coastMap;
 
 	numberOfMaps=14;
+
+	// defaults are read from flash, RAM copy is made when map is loaded or edited
+	mapArenaUsed = 0;
+	mapShadow = mapAllocate(allMaps::largest);
+	for (unsigned char idx=0;idx<numberOfMaps;idx++)
+		mapPrepare(&mapInfo[idx],maps[idx],true);
+	groupMaps();
+
+#ifdef MAP_HEATMAP
+	// hit counters for 2D maps, in map index order while arena has space
+	unsigned int heatmapUsed = 0;
+	for (unsigned char idx=0;idx<numberOfMaps;idx++) {
+		unsigned int cells = mapInfo[idx].sizeX*mapInfo[idx].sizeY;
+		if (mapInfo[idx].sizeY>1 && heatmapUsed+cells <= MAP_HEATMAP_ARENA_SIZE) {
+			mapInfo[idx].heat = heatmapArena+heatmapUsed;
+			heatmapUsed += cells;
+		} else {
+			mapInfo[idx].heat = NULL;
+		}
+	}
+	memset(heatmapArena,0,sizeof(heatmapArena));
+#endif
+}
+
+// True if map data equals to data saved in EEPROM
+bool Core::mapEqualsEEPROM(unsigned char idx,int ofs,int size) {
+	for (int i=0;i<size;i++) {
+		char c;
+		EEPROMreadData(ofs+i,&c,1);
+		if ((unsigned char)c != mapDataByte(&mapInfo[idx],i))
+			return false;
+	}
+	return true;
+}
+
+// True if breakpoints saved in EEPROM at ofs (sizeX+sizeY bytes) increase on both axes, lookups rely on it
+bool Core::mapAxisValidEEPROM(unsigned char idx,int ofs) {
+	unsigned char sizeX = mapInfo[idx].sizeX;
+	unsigned char size = sizeX+mapInfo[idx].sizeY;
+	unsigned char prev = 0;
+	for (unsigned char i=0;i<size;i++) {
+		unsigned char c;
+		EEPROMreadData(ofs+i,(char*)&c,1);
+		if (i != 0 && i != sizeX && c <= prev)
+			return false;
+		prev = c;
+	}
+	return true;
+}
+
+// Limits cells of loaded 'W' map to MAP_WIDE_CELL_MAX, true if any cell was out of range
+bool Core::mapClampWideCells(unsigned char idx) {
+	mapInfoStruct *map = &mapInfo[idx];
+	uint16_t *cells = (uint16_t*)map->cells;
+	bool clamped = false;
+	for (unsigned char i=0;i<map->sizeX*map->sizeY;i++) {
+		if (cells[i] > MAP_WIDE_CELL_MAX) {
+			cells[i] = MAP_WIDE_CELL_MAX;
+			clamped = true;
+		}
+	}
+	return clamped;
+}
+
+// Takes RAM for map data from map arena, NULL if arena is full
+unsigned char *Core::mapAllocate(unsigned int size) {
+	if (mapArenaUsed+size > sizeof(mapArena)) {
+		dtc.setError(DTC_MAP_MEMORY_FULL);
+		return NULL;
+	}
+	unsigned char *ram = mapArena+mapArenaUsed;
+	mapArenaUsed += size;
+	return ram;
+}
+
+// Points lookups of map to another copy of its data (same layout), caller takes care of atomicity
+void Core::mapRedirect(unsigned char idx,unsigned char *data) {
+	mapInfoStruct *map = &mapInfo[idx];
+	if (map->axisX) {
+		map->axisX = data+(map->axisX-map->data);
+		map->axisY = data+(map->axisY-map->data);
+	}
+	map->cells = data+(map->cells-map->data);
+	map->data = data;
+	map->flash = false;
+	maps[idx] = data;
+}
+
+// Returns writable RAM copy of map, copy of the flash default is taken from map arena on first call.
+// NULL if arena is full. Use beginMapEdit() instead when engine may be running.
+unsigned char *Core::mapWritable(unsigned char idx) {
+	mapInfoStruct *map = &mapInfo[idx];
+	if (!map->flash)
+		return (unsigned char*)maps[idx];
+	unsigned char *ram = mapAllocate(mapBlobSize(map));
+	if (!ram)
+		return NULL;
+	memcpy_P(ram,maps[idx],mapBlobSize(map));
+
+	cli();
+	mapRedirect(idx,ram);
+	sei();
+	return ram;
+}
+
+/*
+	Map edits while engine is running are double buffered: beginMapEdit() returns shadow copy of the map,
+	commitMapEdit() makes it live. Redirect only changes cached pointers, it is done with interrupts disabled 
+	for a few cycles from main loop, i.e. between fast sensor ticks, so lookups never see a half applied 
+	edit. Lookups use the shadow while the edit is copied back to map's own RAM, then they are redirected
+	back, so one shadow (size of the largest map) serves all maps. Edit of one map at a time, main loop only.
+*/
+unsigned char *Core::beginMapEdit(unsigned char idx) {
+	if (!mapShadow || !mapWritable(idx))
+		return NULL;
+	memcpy(mapShadow,maps[idx],mapBlobSize(&mapInfo[idx]));
+	return mapShadow;
+}
+
+void Core::commitMapEdit(unsigned char idx) {
+	unsigned char *own = (unsigned char*)maps[idx];
+	cli();
+	mapRedirect(idx,mapShadow);
+	sei();
+	memcpy(own,mapShadow,mapBlobSize(&mapInfo[idx]));
+	cli();
+	mapRedirect(idx,own);
+	sei();
+}
+
+// Copies controls to controlsSnapshot without disabling interrupts, copy is retried if an interrupt
+// handler has published new values meanwhile. Main loop only.
+void Core::takeControlsSnapshot() {
+	unsigned char seq;
+	do {
+		seq = controlsSeq;
+		for (unsigned char i=0;i<=VALUE_MAX;i++)
+			controlsSnapshot[i] = controls[i];
+	} while (seq != controlsSeq);
+}
+
+#ifdef MAP_HEATMAP
+// Halve hit counters, so heatmap follows recent operation. Counter updated by interrupt meanwhile may lose one hit.
+void Core::decayHeatmaps() {
+	for (unsigned int i=0;i<sizeof(heatmapArena);i++)
+		heatmapArena[i] >>= 1;
+}
+
+void Core::clearHeatmap(unsigned char idx) {
+	if (mapInfo[idx].heat)
+		memset(mapInfo[idx].heat,0,mapInfo[idx].sizeX*mapInfo[idx].sizeY);
+}
+#endif
+
+// Give maps with identical axes same axesId, so one mapLocate() result can be used for all of them
+void Core::groupMaps() {
+	for (unsigned char idx=0;idx<numberOfMaps;idx++) {
+		unsigned char id = idx;
+		for (unsigned char i=0;i<idx;i++) {
+			if (mapSharesAxes(&mapInfo[i],&mapInfo[idx])) {
+				id = mapInfo[i].axesId;
+				break;
+			}
+		}
+		mapInfo[idx].axesId = id;
+	}
 }
 
 /*
@@ -458,16 +658,20 @@ void Core::save() {
 	}
 	// Write maps
 	for (idx = 0;idx<numberOfMaps;idx++) {
-		char x = core.maps[idx][5];
-		char y = core.maps[idx][6];
-		
-		size = x*y+15;
+		size = mapDataSize(&mapInfo[idx]);
 
-		EEPROMwriteData(ofs,(char*)core.maps[idx],2); // File id 
+		// map data may be in flash, copy byte by byte
+		for (int i=0;i<2;i++) {
+			char c = mapDataByte(&mapInfo[idx],i);
+			EEPROMwriteData(ofs+i,&c,1);					// File id
+		}
 		ofs += 2;				
 		EEPROMwriteData(ofs,(char*)&size,2);				// Size
 		ofs += 2;				
-		EEPROMwriteData(ofs,(char*)core.maps[idx],15+x*y);    // Data
+		for (int i=0;i<size;i++) {
+			char c = mapDataByte(&mapInfo[idx],i);
+			EEPROMwriteData(ofs+i,&c,1);					// Data
+		}
 		ofs += size;
 
 	}
@@ -483,8 +687,9 @@ bool Core::load() {
 	unsigned char c1=0,c2=0;
 	int ofs = CONFIGURATION_EEPROM_OFFSET;  
 	unsigned int fileId;
-	int size;  
+	unsigned int size = 0; // 2 bytes in EEPROM
 	int value;
+	bool complete = true; // all saved maps were taken into use
 	char buf[7];
 	EEPROMreadData(ofs,buf,4);
 	buf[4] = 0;
@@ -521,12 +726,60 @@ bool Core::load() {
 
 					for (unsigned char idx = 0;idx<numberOfMaps;idx++) {
 						unsigned int mapId;
-						mapId = (int)core.maps[idx][1]*256+core.maps[idx][0];
+						mapId = (int)mapDataByte(&mapInfo[idx],1)*256+mapDataByte(&mapInfo[idx],0);
 
 						if (mapId == fileId) {
-							if (size == (core.maps[idx][5]*core.maps[idx][6]+15)) {
+							unsigned char x = mapInfo[idx].sizeX;
+							unsigned char y = mapInfo[idx].sizeY;
+							// sizes of maps saved with 8-bit cells, without / with breakpoints
+							unsigned int plainSize = MAP_HEADER_SIZE+x*y+MAP_TRAILER_SAVED;
+							unsigned int breakpointSize = plainSize+x+y;
+							unsigned char *data;
+							// saved breakpoints must be usable, header must match the map type
+							bool axisSaved = (size == mapDataSize(&mapInfo[idx]) && mapInfo[idx].axisX) || size == breakpointSize;
+							if (axisSaved && !mapAxisValidEEPROM(idx,ofs+MAP_HEADER_SIZE)) {
+								dtc.setError(DTC_CONFIGURATION_MISMATCH);
+							} else if (size == mapDataSize(&mapInfo[idx]) && mapEqualsEEPROM(idx,ofs,size)) {
+								// same as default, keep reading it from flash
 								c2++;
-								EEPROMreadData(ofs,(char*)core.maps[idx],size);
+							} else if (size == mapDataSize(&mapInfo[idx]) && !mapEqualsEEPROM(idx,ofs,MAP_HEADER_SIZE)) {
+								dtc.setError(DTC_CONFIGURATION_MISMATCH);
+							} else if (size == mapDataSize(&mapInfo[idx])) {
+								if (!(data = mapWritable(idx))) {
+									complete = false;
+								} else {
+									c2++;
+									EEPROMreadData(ofs,(char*)data,size);
+									mapPrepare(&mapInfo[idx],data,false);
+									if (mapInfo[idx].wide && mapClampWideCells(idx))
+										dtc.setError(DTC_CONFIGURATION_MISMATCH);
+								}
+							} else if (mapInfo[idx].wide && (size == plainSize || size == breakpointSize)) {
+								// map saved with 8-bit cells, load breakpoints (if saved) and widen cells (8-bit value v equals to 4*v)
+								if (!(data = mapWritable(idx))) {
+									complete = false;
+								} else {
+									c2++;
+									int cellOfs = ofs+MAP_HEADER_SIZE;
+									if (size == breakpointSize) {
+										EEPROMreadData(cellOfs,(char*)data+MAP_HEADER_SIZE,x+y);
+										cellOfs += x+y;
+									}
+									uint16_t *cells = (uint16_t*)(data+(mapInfo[idx].cells-mapInfo[idx].data));
+									for (unsigned int i=0;i<(unsigned int)x*y;i++) {
+										unsigned char v;
+										EEPROMreadData(cellOfs+i,(char*)&v,1);
+										cells[i] = v*4;
+									}
+								}
+							} else if (size == plainSize && mapInfo[idx].axisX) {
+								// map saved before breakpoints were introduced, keep default breakpoints and load cells only
+								if (!(data = mapWritable(idx))) {
+									complete = false;
+								} else {
+									c2++;
+									EEPROMreadData(ofs+MAP_HEADER_SIZE,(char*)data+(mapInfo[idx].cells-mapInfo[idx].data),x*y);
+								}
 							} else {
 								dtc.setError(DTC_CONFIGURATION_MISMATCH);
 							}
@@ -537,12 +790,13 @@ bool Core::load() {
 
 			ofs += size;
 		} while (fileId != 0xFFFF);
+		groupMaps();
 		Serial.print(c1);
 		Serial.print(" nodes, ");			
 		Serial.print(c2);
 		Serial.print(" maps..");		
 
-		return true;
+		return complete;
 	} else {
 		// file id not detected, do not load
 		dtc.setError(DTC_CONFIGURATION_ERROR);
@@ -550,51 +804,6 @@ bool Core::load() {
 	return false;
 }
 
-void Core::save_old() {
-	// TODO new format
-	// <id><len><data><cksum>
-	// <id><len><data><cksum> ...
-	// 
-	// conf saved as node<->value pairs
-	// tables "as it is" (check allocated size in preinitalized header vs. stored size)
-	
-	int ofs = CONFIGURATION_EEPROM_OFFSET;    
-	// write header
-	EEPROMwriteData(ofs,(char*)CONFIGURATION_FILE_4BYTE_ID,4);
-	ofs += 4;
-	// write size
-	int size = sizeof(node);
-	EEPROMwriteData(ofs,(char*)&size,2);
-	ofs += 2;
-	// write contents - core nodes
-	EEPROMwriteData(ofs,(char*)&node,size);
-	ofs += size;  
-
-	// write map data
-	for (unsigned char i=0;i<numberOfMaps;i++) {
-		char x = core.maps[i][3];
-		char y = core.maps[i][4];
-		EEPROMwriteData(ofs,(char*)core.maps[i],13+x*y);
-		ofs += 13+x*y;
-	}
-	// write contents - map data -- todo better structure!!
-	//EEPROMwriteData(ofs,(char*)&basicFuelMap,sizeof(basicFuelMap));
-	
-	/* ****
-	EEPROMwriteData(ofs,(char*)core.maps[0],13+8*6);
-	ofs += 13+8*6;
-	
-	EEPROMwriteData(ofs,(char*)core.maps[1],13+8*4);
-	ofs += 13+8*4;
-
-	**** */
-
-	//EEPROMwriteData(ofs,(char*)core.maps[2],13+5*1);
-	//ofs += 13+5*1;
-	
-	confeditor.setSystemStatusMessage("Saved");
-}
-
 void Core::setCurrentNode(int start) {
 	if (start<=NODE_MAX) { 
 		currentNode = start;
@@ -638,6 +847,9 @@ void Core::setValue(int value) {
 		if (value > node[currentNode].max) 
 			value = node[currentNode].max;
 	
+		// 16-bit value is read by interrupt handlers
+		cli();
 		node[currentNode].value = value;
+		sei();
 	}
 }
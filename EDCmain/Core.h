@@ -3,6 +3,7 @@
 
 #include "defines.h"
 #include "Arduino.h"
+#include "Map.h"
 
 // Purpose of Core class is to provide one place where introduce new variables, their limits and binds to actual sensor values
 // So, all variables (See Core.cpp ::constructor) are automatically configurable via configuration interface
@@ -119,11 +120,17 @@ public:
     static const unsigned char valueRpmDeviation6 = 70;
     static const unsigned char valueFan1State = 71;
     static const unsigned char valueEngineRPMErrors = 72;
-    static const unsigned char VALUE_MAX = 73;
+    static const unsigned char valueStackMargin = 73;
+    static const unsigned char valueHeapUsed = 74;
+    static const unsigned char VALUE_MAX = 75;
 
 
     // Storage for sensors values and such
     volatile int controls[Core::VALUE_MAX+1];    
+    // Interrupt handlers that write controls (Timer3 handlers, crank tasks, RPM trigger and stall) call
+    // publishControls() when done. UI and telemetry read coherent copy, see takeControlsSnapshot()
+    volatile unsigned char controlsSeq;
+    int controlsSnapshot[Core::VALUE_MAX+1];
     
     // nodes for configurable items (itemNode)
     static const unsigned char nodeSoftwareVersion = 0;  
@@ -253,20 +260,42 @@ public:
     
     // unsigned char basicFuelMap[13+6*6];
     // unsigned char boostMap[13+8*8];
-    unsigned char *maps[32];
-    const char *mapNames[32];
+    static const unsigned char MAP_MAX = 16;
+    const unsigned char *maps[MAP_MAX]; // flash default (PROGMEM) or RAM copy, see mapInfo[].flash
+    const char *mapNames[MAP_MAX]; // PROGMEM strings
+    mapInfoStruct mapInfo[MAP_MAX];
+    unsigned char mapArena[MAP_RAM_ARENA_SIZE]; // RAM copies of loaded / edited maps
+    unsigned int mapArenaUsed;
+    unsigned char *mapShadow; // edit copy shared by all maps, see beginMapEdit()
+#ifdef MAP_HEATMAP
+    unsigned char heatmapArena[MAP_HEATMAP_ARENA_SIZE];
+#endif
     unsigned char numberOfMaps;
     
 private:
     unsigned int currentNode;
+    unsigned char *mapAllocate(unsigned int size);
+    bool mapAxisValidEEPROM(unsigned char idx,int ofs);
+    bool mapClampWideCells(unsigned char idx);
+    void mapRedirect(unsigned char idx,unsigned char *data);
     
     
 public:    
     Core();
     void save();
     bool load();
-    void save_old();
-    bool load_old();
+
+    void groupMaps();
+    unsigned char *mapWritable(unsigned char idx);
+    unsigned char *beginMapEdit(unsigned char idx);
+    void commitMapEdit(unsigned char idx);
+    bool mapEqualsEEPROM(unsigned char idx,int ofs,int size);
+    inline void publishControls() { controlsSeq++; }
+    void takeControlsSnapshot();
+#ifdef MAP_HEATMAP
+    void decayHeatmaps();
+    void clearHeatmap(unsigned char idx);
+#endif
 
     void setCurrentNode(int start = LIST_RESET);
     nodeStruct* getNextNode();
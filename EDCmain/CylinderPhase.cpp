@@ -0,0 +1,64 @@
+#include "CylinderPhase.h"
+#include "EventQueue.h"
+#include "DTC.h"
+
+static const unsigned char firingOrder[NUMBER_OF_CYLINDERS] = FIRING_ORDER;
+static unsigned char firingPosition[NUMBER_OF_CYLINDERS]; // by cylinder index, 0 = needle lift sensor cylinder
+
+static volatile unsigned char phaseSlot;
+static volatile unsigned char phaseValid;
+static volatile unsigned char candidateSlot;
+static volatile unsigned char candidateCount;
+
+void cylinderPhaseInit() {
+	unsigned char needle = 0;
+	for (unsigned char i=0;i<NUMBER_OF_CYLINDERS;i++)
+		if (firingOrder[i] == NEEDLELIFTSENSOR_CYLINDER)
+			needle = i;
+	for (unsigned char i=0;i<NUMBER_OF_CYLINDERS;i++)
+		firingPosition[firingOrder[i]-1] = (i+NUMBER_OF_CYLINDERS-needle)%NUMBER_OF_CYLINDERS;
+	cylinderPhaseReset();
+}
+
+unsigned char cylinderPhaseNeedle(unsigned char slot) {
+	if (phaseValid && slot == phaseSlot) {
+		candidateCount = 0;
+		return CYLINDER_PHASE_OK;
+	}
+	if (candidateCount && slot == candidateSlot) {
+		candidateCount++;
+	} else {
+		candidateSlot = slot;
+		candidateCount = 1;
+	}
+	if (candidateCount < CYLINDER_PHASE_CONFIRM)
+		return CYLINDER_PHASE_NOISE;
+	if (phaseValid)
+		eventPost(EVENT_DTC,DTC_NEEDLESENSOR_UNPLAUSIBLE_SIGNAL,slot);
+	phaseSlot = slot;
+	phaseValid = 1;
+	candidateCount = 0;
+	return CYLINDER_PHASE_SYNC;
+}
+
+void cylinderPhaseReset() {
+	phaseValid = 0;
+	candidateCount = 0;
+}
+
+bool cylinderPhaseValid() {
+	return phaseValid;
+}
+
+signed char cylinderPhaseSlot(unsigned char cyl) {
+	cli();
+	unsigned char valid = phaseValid;
+	unsigned char slot = phaseSlot;
+	sei();
+	if (cyl >= NUMBER_OF_CYLINDERS || !valid)
+		return -1;
+	slot += firingPosition[cyl]*2;
+	if (slot >= CYLINDER_PHASE_SLOTS)
+		slot -= CYLINDER_PHASE_SLOTS;
+	return slot;
+}
@@ -0,0 +1,35 @@
+#ifndef CYLINDERPHASE_H
+#define CYLINDERPHASE_H
+
+#include "defines.h"
+#include "Arduino.h"
+
+/*
+	Cylinder phase (720°) from needle lift sensor. Decoder divides the engine cycle to
+	CYLINDER_PHASE_SLOTS crank periods (two per cylinder, e.g. mark to mark) and reports the slot
+	where needle lift pulse was seen. Slot of the pulse is the first slot of NEEDLELIFTSENSOR_CYLINDER,
+	other cylinders follow in FIRING_ORDER, two slots each.
+
+	Noise: decoder passes only first pulse per slot. Pulse in other slot than current phase has to be
+	seen at the same slot on CYLINDER_PHASE_CONFIRM consecutive pulses before phase is moved (counted
+	as DTC_NEEDLESENSOR_UNPLAUSIBLE_SIGNAL), a single good pulse clears the candidate. Missing pulses
+	(fuel cut) keep the phase. Decoder resets phase on stall and when its own slot counting restarts.
+*/
+
+#define CYLINDER_PHASE_SLOTS (NUMBER_OF_CYLINDERS*2)
+#define CYLINDER_PHASE_CONFIRM 3 /* also needed for the first sync after start */
+
+#define CYLINDER_PHASE_NOISE 0 /* pulse does not match the phase (yet) */
+#define CYLINDER_PHASE_OK 1
+#define CYLINDER_PHASE_SYNC 2 /* phase was set or moved by this pulse */
+
+void cylinderPhaseInit();
+
+// Decoder side, call from interrupt (interrupts disabled)
+unsigned char cylinderPhaseNeedle(unsigned char slot);
+void cylinderPhaseReset();
+
+bool cylinderPhaseValid();
+signed char cylinderPhaseSlot(unsigned char cyl); // first slot of cylinder (0 = cylinder 1), -1 if not known. Main loop only
+
+#endif
@@ -4,17 +4,19 @@
 #include <EEPROM.h>
 #include "utils.h"
 #include "ConfEditor.h"
+#include "TimeBase.h"
 
 DTC dtc;
 
 // private
 DTC::DTC() {
+    statusPending = -1;
     load();
     iterator = -1;
 }
 void DTC::save() {
-    if (isTouched && millis() - lastSave >5000) {
-        lastSave = millis();
+    if (isTouched && now_us() - lastSave > 5000000L) {
+        lastSave = now_us();
         saveToEEPROM();
     }
 }
@@ -73,10 +75,18 @@ void DTC::setError(unsigned int dtc) {
         && errorCodesCurrent[dtc] == errorCodesOnStartup[dtc]) {
         isTouched = true;
         errorCodesCurrent[dtc]++;
-        confeditor.setSystemStatusMessage(fetchFromFlash(DTC_CODES[dtc]));
+        // setError may run inside UI output (uiSerial wait hook), which owns flashFetchBuffer and status message
+        statusPending = dtc;
     }
 }
 
+void DTC::publishStatus() {
+    if (statusPending < 0)
+        return;
+    confeditor.setSystemStatusMessage(fetchFromFlash(DTC_CODES[statusPending]));
+    statusPending = -1;
+}
+
 void DTC::resetAll() {
     memset(errorCodesCurrent,0,sizeof(errorCodesOnStartup));
     memset(errorCodesOnStartup,0,sizeof(errorCodesOnStartup));
@@ -33,6 +33,8 @@
 #define DTC_TPS_UNPLAUSIBLE 19
 
 #define DTC_CONFIGURATION_MISMATCH 20
+#define DTC_MAP_MEMORY_FULL 21
+#define DTC_MEMORY_LOW 22
 
 
 #define MAX_DTCS 64
@@ -63,8 +65,8 @@ static const char DTC_CODES[MAX_DTCS][MAX_DTC_LEN] PROGMEM =
     "Air temperature sensor unconnected", // 18
     "TPS signal unplausible", // 19
     "Configuration mismatch", // 20
-    "Unknown DTC Code 21", // 21
-    "Unknown DTC Code 22", // 22
+    "Map memory full, default map used", // 21
+    "Low memory, stack margin below limit", // 22
     "Unknown DTC Code 23", // 23
     "Unknown DTC Code 24", // 24
     "Unknown DTC Code 25", // 25
@@ -110,9 +112,10 @@ static const char DTC_CODES[MAX_DTCS][MAX_DTC_LEN] PROGMEM =
 
 class DTC {
 private:
-    long lastSave;
+    unsigned long lastSave; // now_us()
     int iterator;
     bool isTouched;
+    int statusPending; // DTC to show as status message, -1 = none
     
     unsigned char errorCodesOnStartup[MAX_DTCS];    
     unsigned char errorCodesCurrent[MAX_DTCS];
@@ -125,7 +128,8 @@ public:
     char *getName();
     unsigned char getCount();
     int getIndex();
-    void setError(unsigned int dtc);
+    void setError(unsigned int dtc); // main loop only, interrupt handlers post EVENT_DTC (EventQueue.h)
+    void publishStatus(); // status message of latest DTC, loop() only (not from tasks run during UI output)
     void resetAll();
     void save();
     boolean isErrorActive(unsigned int dtc);
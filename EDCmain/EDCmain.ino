@@ -39,7 +39,7 @@ Todo:
 
 */
 #include "RPMDefaultCPS.h"
-//#include "RPMCustomCps.h"
+#include "RPMToothWheel.h"
 #include "ConfEditor.h"
 #include "Core.h"
 #include "QuantityAdjuster.h"
@@ -51,51 +51,158 @@ Todo:
 #include "PID.h"
 #include "TachoOut.h"
 #include "BackgroundADC.h"
-
-extern volatile long rpmMax;
-extern volatile long rpmMin;
+#include "TaskStats.h"
+#include "TimeBase.h"
+#include "EventQueue.h"
+#include "Trace.h"
+#include "UiSerial.h"
 
 // some debug toggles
 volatile static char qaTemporaryDisabled = 0;
 static char qaFollowsTPS = 0;
 
 
-// Crankshaft position sensor decoding, use RPMDefaultCps or RPMHiDensityCps 
+// Crankshaft position sensor decoding, RPMDefaultCps (one mark per cylinder) or RPMToothWheel 
+#ifdef RPM_SENSOR_TYPE_TOOTH_WHEEL
+typedef RPMToothWheel<RPM_TOOTH_WHEEL_TEETH,RPM_TOOTH_WHEEL_MISSING,NUMBER_OF_CYLINDERS> RPMToothWheelType;
+static RPMToothWheelType rpm;
+RPM_TOOTH_WHEEL_ISR(RPMToothWheelType)
+#else
 static RPMDefaultCps rpm;
+#endif
 
 // VP37 Quantity adjuster module
 static QuantityAdjuster adjuster;
 
 //TachoOut tacho;
 
-// Periodic routines called by 2500Hz (or less, set divider to 2 or greater)
+// Periodic routines called by Timer3 tick (500Hz), or every n:th tick (divider). Only registered handlers
+// are kept in array, in order of priority (0 = highest). Phase offsets the first call so that handlers
+// with same divider can be spread over different ticks.
 #define interruptHandlerMax 8
 
 volatile struct interruptHandlerStruct { 
 	void (*handler)();
 	unsigned char divider;
+	unsigned char countdown; // ticks to next call
+	unsigned char priority;
+	unsigned char stats; // TASK_STATS_* id
 } interruptHandlerArray[interruptHandlerMax];
 
-volatile unsigned char shortTicks=0;
+volatile unsigned char interruptHandlerCount=0;
 volatile unsigned int intHandlerCalls;
 
-// Called when Timer3 overflow occurs. Then calls handler routines according to their divider value
+void addInterruptHandler(void (*handler)(),unsigned char divider,unsigned char phase,unsigned char priority,unsigned char stats) {
+	unsigned char oldSREG = SREG;
+	cli();
+	unsigned char i = interruptHandlerCount;
+	if (i < interruptHandlerMax) {
+		// insertion sort by priority
+		while (i > 0 && interruptHandlerArray[i-1].priority > priority) {
+			memcpy((void*)&interruptHandlerArray[i],(const void*)&interruptHandlerArray[i-1],sizeof(interruptHandlerStruct));
+			i--;
+		}
+		interruptHandlerArray[i].handler = handler;
+		interruptHandlerArray[i].divider = divider ? divider : 1;
+		interruptHandlerArray[i].countdown = phase % interruptHandlerArray[i].divider + 1;
+		interruptHandlerArray[i].priority = priority;
+		interruptHandlerArray[i].stats = stats;
+		interruptHandlerCount++;
+	}
+	SREG = oldSREG;
+}
+
+// Called when Timer3 overflow occurs. Then calls handler routines which countdown expires.
+// Timer3 interrupt is masked while handlers run, so handler can not be re-entered: a tick that 
+// occurs meanwhile stays pending and is served right after (late ticks show up as jitter in task statistics).
 void mainInterruptHandler() {
+	TIMSK3 &= ~_BV(TOIE3);
 	intHandlerCalls++;
+	TASK_STATS_BEGIN(TASK_STATS_TIMER3);
+	TRACE_ENTER(TRACE_TIMER3,0);
+
+	unsigned char due = 0; // bit per handler
+	for (unsigned char i=0;i<interruptHandlerCount;i++) {
+		if (--interruptHandlerArray[i].countdown == 0) {
+			interruptHandlerArray[i].countdown = interruptHandlerArray[i].divider;
+			due |= 1<<i;
+		}
+	}
+	// Crank tasks (fuel calculation) would delay priority 0 handlers (QA servo), they are held until
+	// lower priority handlers are reached
+	bool crankHeld = true;
+	rpm.holdCrankTasks(true);
 	// Enable nested interrupts to not miss (or wrongly) calculate RPM signal 
 	sei();
-
-	for (unsigned char i=0;i<interruptHandlerMax;i++) {
-		if (interruptHandlerArray[i].handler != NULL 
-			&& (interruptHandlerArray[i].divider == 0
-				|| (shortTicks % interruptHandlerArray[i].divider == 0))) {
+	for (unsigned char i=0;due;i++) {
+		if (crankHeld && interruptHandlerArray[i].priority > 0) {
+			cli();
+			rpm.holdCrankTasks(false);
+			sei();
+			crankHeld = false;
+		}
+		if (due & (1<<i)) {
+			TRACE_ENTER(TRACE_TIMER3_TASK,i);
+			TASK_STATS_BEGIN(interruptHandlerArray[i].stats);
 			interruptHandlerArray[i].handler();
+			TASK_STATS_END(interruptHandlerArray[i].stats);
+			TRACE_LEAVE(TRACE_TIMER3_TASK,i);
+			due &= ~(1<<i);
 		}
 	}
-	shortTicks++;
+	TRACE_LEAVE(TRACE_TIMER3,0);
+	TASK_STATS_END(TASK_STATS_TIMER3);
+	cli();
+	if (crankHeld)
+		rpm.holdCrankTasks(false);
+	core.publishControls();
 	intHandlerCalls--;
+	TIMSK3 |= _BV(TOIE3);
 } 
 
+#ifdef CRANK_SYNC_FUEL
+// Above cranking speed fuel amount is calculated at fixed angle before each injection (crank angle task),
+// otherwise (and if RPM decoder does not support crank tasks) by Timer3. Busy flag keeps the two
+// from running refreshFastSensors on top of each other during transition. Below ~1500rpm marks are
+// further apart than the timer period, Timer3 fills in if the crank task has not run for half a period,
+// so fuel is updated at least every 1.5 periods (83Hz).
+static bool fuelCrankSynced = false;
+volatile static char fastSensorsBusy = 0;
+static volatile unsigned long fuelCrankTime; // now_us() of latest crank task update
+
+void refreshFastSensors();
+
+static void refreshFastSensorsExclusive() {
+	cli();
+	if (fastSensorsBusy) {
+		sei();
+		return;
+	}
+	fastSensorsBusy = 1;
+	sei();
+	refreshFastSensors();
+	fastSensorsBusy = 0;
+}
+
+void refreshFastSensorsTimed() {
+	if (fuelCrankSynced && core.controls[Core::valueEngineRPMFiltered] > ENGINE_RPM_CRANKING_LIMIT) {
+		cli();
+		unsigned long since = now_us()-fuelCrankTime;
+		sei();
+		if (since < FUEL_UPDATE_PERIOD_US/2)
+			return;
+	}
+	refreshFastSensorsExclusive();
+}
+
+void refreshFastSensorsCrank() {
+	if (core.controls[Core::valueEngineRPMFiltered] <= ENGINE_RPM_CRANKING_LIMIT)
+		return;
+	refreshFastSensorsExclusive();
+	fuelCrankTime = now_us();
+}
+#endif
+
 void refreshQuantityAdjuster() {
 //	if (!qaTemporaryDisabled)
 	adjuster.update(qaTemporaryDisabled);
@@ -117,7 +224,7 @@ void doIdlePidControl() {
 	if (core.node[Core::nodeIdleKp].value<2) {
 		pidP = core.node[Core::nodeIdleKp].value;
 	} else {
-		pidP = mapLookUp(core.maps[Core::mapIdxIdlePidP],rpmIdle,0);	
+		pidP = mapLookUp(&core.mapInfo[Core::mapIdxIdlePidP],rpmIdle,0);	
 	}
 
 	static PID idlePidControl(
@@ -197,7 +304,7 @@ void refreshSlowSensors() {
 
 	// Gearbox TEMP
 //	value = adc.readValueAvarage(PIN_ANALOG_TEMP_GEARBOX);
-/*	scaledValue = mapLookUp(core.maps[Core::mapIdxAirTempSensorMap], value / 4, 0);		
+/*	scaledValue = mapLookUp(&core.mapInfo[Core::mapIdxAirTempSensorMap], value / 4, 0);		
 	if (value > ANALOG_INPUT_HIGH_STATE_LIMIT) {
 		// generate error only if map is configured and sensor reading is not present
 		if (scaledValue > 0)
@@ -259,8 +366,10 @@ void refreshSlowSensors() {
 	// Log adjuster accuracy for debugging
 	core.controls[Core::valueQAJitter] = adjuster.accuracy; 
 	core.node[Core::nodeQADebugJitter].value = adjuster.setPointMax - adjuster.setPointMin;
+	cli();
 	adjuster.setPointMax=0;
 	adjuster.setPointMin=2000;
+	sei();
 	
 	// Register current injection timing (*10 fixed point)
 	core.controls[Core::valueEngineTimingActual] = rpm.getInjectionTiming();
@@ -274,6 +383,9 @@ void refreshSlowSensors() {
 		2 = closed loop control, PID control from target table
 
 */
+// Cell position of current RPM x injected fuel operating point, updated in loop()
+static mapCellStruct loadMapCell;
+
 void doTimingControl() {
 	if (core.controls[Core::valueOutputTestMode] != 0 || core.node[Core::nodeTimingMethod].value == 0) {	
 			analogWrite(PIN_PWM_TIMING_SOLENOID,0);					
@@ -281,9 +393,7 @@ void doTimingControl() {
 	}
 	if (core.node[Core::nodeTimingMethod].value == 1) {
 		if (core.controls[Core::valueRunMode]>=ENGINE_STATE_IDLE) {
-			core.controls[Core::valueEngineTimingDutyCycle] = mapLookUp(core.maps[Core::mapIdxOpenLoopAdvanceMap],
-					core.controls[Core::valueRPM8bit],
-					core.controls[Core::valueFuelAmount8bit]);				
+			core.controls[Core::valueEngineTimingDutyCycle] = mapRead(&core.mapInfo[Core::mapIdxOpenLoopAdvanceMap],&loadMapCell);				
 			analogWrite(PIN_PWM_TIMING_SOLENOID,core.controls[Core::valueEngineTimingDutyCycle]);	
 		} else {
 			analogWrite(PIN_PWM_TIMING_SOLENOID,0);				
@@ -296,9 +406,7 @@ void doTimingControl() {
 		/* closed loop mode */
 
 
-		core.controls[Core::valueEngineTimingTarget] = mapLookUp(core.maps[Core::mapIdxClosedLoopAdvanceMap],
-			core.controls[Core::valueRPM8bit],
-			core.controls[Core::valueFuelAmount8bit]);	
+		core.controls[Core::valueEngineTimingTarget] = mapRead(&core.mapInfo[Core::mapIdxClosedLoopAdvanceMap],&loadMapCell);	
 
 		static int timingKd = 0, timingSpeed=16, timingMin=N108_MIN_DUTY_CYCLE, timingMax=N108_MAX_DUTY_CYCLE;
 		static PID timingPidControl(
@@ -367,7 +475,7 @@ void doBoostControl() {
 
 
 	/* Look up for requested boost level (RPM x TPS) */
-	unsigned char res = mapLookUp(core.maps[Core::mapIdxTurboTargetPressureMap],
+	unsigned char res = mapLookUp(&core.mapInfo[Core::mapIdxTurboTargetPressureMap],
 		core.controls[Core::valueRPM8bit],
 		core.controls[Core::valueTPSActual]);	
 	cli();
@@ -376,9 +484,7 @@ void doBoostControl() {
 
 	/* TODO: add check for overboost situations and set up DTC and safe mode */
 
-	core.controls[Core::valueBoostValveDutyCycle] =  mapLookUp(core.maps[Core::mapIdxTurboControlMap],
-		core.controls[Core::valueRPM8bit],
-		core.controls[Core::valueFuelAmount8bit]);	
+	core.controls[Core::valueBoostValveDutyCycle] =  mapRead(&core.mapInfo[Core::mapIdxTurboControlMap],&loadMapCell);	
 
 
 	// for ui
@@ -424,7 +530,7 @@ void doBoostControl() {
 			}
 			core.controls[Core::valueBoostCalculatedAmount] = idx;
 			
-			out = mapLookUp(core.maps[Core::mapIdxActuatorTension],idx,0); 
+			out = mapLookUp(&core.mapInfo[Core::mapIdxActuatorTension],idx,0); 
 
 			core.controls[Core::valueN75DutyCycle] = out;
 			break;
@@ -440,7 +546,7 @@ void doBoostControl() {
 			}
 			idx = idx;
 	   	
-		   	core.controls[Core::valueN75DutyCycle] = mapLookUp(core.maps[Core::mapIdxActuatorTension],idx,0); 
+		   	core.controls[Core::valueN75DutyCycle] = mapLookUp(&core.mapInfo[Core::mapIdxActuatorTension],idx,0); 
 		   	break;
 		  	case 4:
 			// Classic vnt lda style + small PID correction
@@ -465,10 +571,10 @@ void doBoostControl() {
 		    	idx = 255;
 		    }
 
-		    out = 255-mapLookUp(core.maps[Core::mapIdxActuatorTension],idx,0); 
+		    out = 255-mapLookUp(&core.mapInfo[Core::mapIdxActuatorTension],idx,0); 
 
 /*
-			out = 255-mapLookUp(core.maps[Core::mapIdxActuatorTension],idx,0); 
+			out = 255-mapLookUp(&core.mapInfo[Core::mapIdxActuatorTension],idx,0); 
 
 		   	// scale value
 		   	joo = map(out,0,255,0,core.controls[Core::valueBoostValveDutyCycle]);   	
@@ -560,7 +666,7 @@ void refreshFastSensors() {
 		// TODO Use idle pid control map or basic map, depending which one is larger to provide smooth transition 
 		// TODO May cause bad engine braking, check it out
 		rpmIdle = mapValues(core.controls[Core::valueEngineRPMFiltered],0,1024);
-		int amountPIDIdle = mapLookUp10bit(core.maps[Core::mapIdxIdleMap],
+		int amountPIDIdle = mapLookUp10bit(&core.mapInfo[Core::mapIdxIdleMap],
 			rpmIdle,
 			core.controls[Core::valueTempEngine]);
 
@@ -568,10 +674,7 @@ void refreshFastSensors() {
 			core.controls[Core::valueRunMode]=ENGINE_STATE_CRANKING;			
 		} 
 
-		rpmCorrected = mapValues(core.controls[Core::valueEngineRPMFiltered],0,core.node[Core::nodeControlMapScaleRPM].value);   
-		core.controls[Core::valueRPM8bit] = rpmCorrected;
-
-		int amountBase = mapLookUp10bit(core.maps[Core::mapIdxFuelMap],
+		int amountBase = mapLookUp10bit(&core.mapInfo[Core::mapIdxFuelMap],
 			rpmCorrected,
 			core.controls[Core::valueTPSActual]);
 
@@ -591,7 +694,7 @@ void refreshFastSensors() {
 
 		// Smooth transition to PID Idle to engine coast
 		if (core.controls[Core::valueTPSActual] == 0) {
-			unsigned int coastAmount = mapLookUp10bit(core.maps[Core::mapIdxCoastingFuelLimit],rpmCorrected,0);
+			unsigned int coastAmount = mapLookUp10bit(&core.mapInfo[Core::mapIdxCoastingFuelLimit],rpmCorrected,0);
 			if (core.controls[Core::valueFuelBaseAmount]>coastAmount)
 				core.controls[Core::valueFuelBaseAmount] = coastAmount;
 		}
@@ -604,7 +707,7 @@ void refreshFastSensors() {
 
 		// Enrichment based on boost, amount is TPS% * fuel enrichment map value to smooth apply of enrichment
 		core.controls[Core::valueFuelEnrichmentAmount] = 
-		((unsigned long)(mapLookUp10bit(core.maps[Core::mapIdxBoostMap],
+		((unsigned long)(mapLookUp10bit(&core.mapInfo[Core::mapIdxBoostMap],
 				rpmCorrected,
 				boostRequlated)) 
 			*(unsigned  long)(core.controls[Core::valueTPSActual])
@@ -627,10 +730,20 @@ void refreshFastSensors() {
 		}
 	}
 
-	if (core.node[Core::nodeFuelMapSmoothness].value>0) {
+	// Smoothness is the part of previous amount kept per FUEL_UPDATE_PERIOD_US. Updates come from crank
+	// marks or timer at varying intervals, so coefficient is dt/(tau+dt), tau = period*s/(100-s)
+	static unsigned long smoothingTime;
+	unsigned long now = now_us();
+	unsigned long dt = now-smoothingTime;
+	smoothingTime = now;
+	if (dt > FUEL_UPDATE_PERIOD_US*8)
+		dt = FUEL_UPDATE_PERIOD_US*8;
+	int smoothness = core.node[Core::nodeFuelMapSmoothness].value;
+	if (smoothness>0) {
 		float input = fuelAmount;
 		float output = core.controls[Core::valueFuelAmount];
-	    output += (input-output) * ((float)(100-core.node[Core::nodeFuelMapSmoothness].value)/100.0);
+		float k = (float)dt*(100-smoothness);
+	    output += (input-output) * (k/(k+(float)FUEL_UPDATE_PERIOD_US*smoothness));
 		core.controls[Core::valueFuelAmount] = output;	
 	} else {		
 		core.controls[Core::valueFuelAmount] = fuelAmount;	
@@ -655,7 +768,7 @@ void doRelayControl() {
 	if (core.controls[Core::valueOutputTestMode] == 0) {
 		// if not in output test mode, performn normal operation
 		if (core.controls[Core::valueEngineRPM] == 0) {
-			unsigned char len = mapLookUp(core.maps[Core::mapIdxGlowPeriodMap],core.controls[Core::valueTempEngine],0);
+			unsigned char len = mapLookUp(&core.mapInfo[Core::mapIdxGlowPeriodMap],core.controls[Core::valueTempEngine],0);
 			if (halfSeconds<=len) {
 				int step = 500+((int)len-(int)halfSeconds)*500;
 				tacho.setRpm(step);		
@@ -688,7 +801,7 @@ void doRelayControl() {
 	digitalWrite(PIN_RELAY_ENGINE_GLOW,core.controls[Core::valueOutputGlow]);
 	digitalWrite(PIN_RELAY_FAN1,core.controls[Core::valueFan1State]);	
 
-	unsigned char emulatedOutput = mapLookUp(core.maps[Core::mapIdxtempSenderMap],core.controls[Core::valueTempEngine],0);	
+	unsigned char emulatedOutput = mapLookUp(&core.mapInfo[Core::mapIdxtempSenderMap],core.controls[Core::valueTempEngine],0);	
 	analogWrite(PIN_PWM_TEMP_SENDER,emulatedOutput);
 }
 
@@ -696,6 +809,7 @@ void doRelayControl() {
 const char main_pressAKeyString[] PROGMEM = " bytes free.\r\n\r\nPress a key for configuration interface ...";
 
 void setup() {
+	paintFreeMemory();
 	pinMode(PIN_INPUT_RPM,INPUT);
 	pinMode(PIN_INPUT_NEEDLELIFTSENSOR,INPUT_PULLUP);
 
@@ -767,16 +881,20 @@ void setup() {
 	Serial.begin(115200);
 	ansiClearScreen();
 
-	interruptHandlerArray[1].handler=refreshFastSensors; 
-	interruptHandlerArray[1].divider=4;
+	taskStatsReset();
+	// odd ticks, QA adjuster runs on even ones
+#ifdef CRANK_SYNC_FUEL
+	addInterruptHandler(refreshFastSensorsTimed,4,1,1,TASK_STATS_FAST_SENSORS);
+#else
+	addInterruptHandler(refreshFastSensors,4,1,1,TASK_STATS_FAST_SENSORS);
+#endif
+	taskStatsInit(TASK_STATS_FAST_SENSORS,4*2000L);
 
 
 
-//	interruptHandlerArray[3].handler=refreshSlowSensors; 
-//	interruptHandlerArray[3].divider=32;
+//	addInterruptHandler(refreshSlowSensors,32,0,2,TASK_STATS_...);
 	
 //	attachInterrupt(0, rpmTrigger, RISING);  // Interrupt 0 -- PIN2 -- LM1815 gated output 
-//	attachInterrupt(1, needleTrigger,FALLING );  // From voltage comparator, default +5v
 	
 	// Timer info - see: http://sobisource.com/?p=195
 
@@ -799,6 +917,9 @@ void setup() {
 
 	setupQATimers(); 
 	rpm.init();
+#ifdef CRANK_SYNC_FUEL
+	fuelCrankSynced = rpm.addCrankTask(refreshFastSensorsCrank,CRANK_SYNC_FUEL_ANGLE,TASK_STATS_CRANK_FUEL);
+#endif
 	adc.init();
 
 	Serial.print("... ");	
@@ -809,6 +930,8 @@ void setup() {
 	//TCCR2B = TCCR2B & (B11111000 | B00000001);    // set timer 2 divisor to     1 for PWM frequency of 31372.55 Hz
 
 	analogWrite(PIN_PWM_NLS_REF_VOLTAGE,73);
+
+	setupLoopTasks();
 }
 
 void setupQATimers() {
@@ -816,27 +939,28 @@ void setupQATimers() {
 	Timer3.initialize(2000); // in microseconds, also sets PWM base frequency for "mega" pins 5,2,3 // 2000 = old default
 	adjuster.initialize();
 
+	addInterruptHandler(refreshQuantityAdjuster,2,0,0,TASK_STATS_QA);
 	Timer3.attachInterrupt(mainInterruptHandler,0);
-	interruptHandlerArray[0].handler=refreshQuantityAdjuster; 
-	interruptHandlerArray[0].divider=2; 
+	taskStatsInit(TASK_STATS_QA,2*2000L);
+	taskStatsInit(TASK_STATS_TIMER3,2000L);
 
 }
 
 void edcConfSendMessage(char *key, char *value) {
 	unsigned char checksum = 0;
-	Serial.write(0x02);
+	uiSerial.write(0x02);
 	for (unsigned char i=0;i<strlen(key);i++) {
 		checksum = (checksum<<1) ^ key[i];
-		Serial.write(key[i]);
+		uiSerial.write(key[i]);
 	}
-	Serial.write(':');
+	uiSerial.write(':');
 	for (unsigned char i=0;i<strlen(value);i++) {
 		checksum = (checksum<<1) ^ value[i];
-		Serial.write(value[i]);
+		uiSerial.write(value[i]);
 	}
-	Serial.write(0x1f);
-	Serial.write(checksum);
-	Serial.write(0x03);
+	uiSerial.write(0x1f);
+	uiSerial.write(checksum);
+	uiSerial.write(0x03);
 }
 
 void edcConfSendStatus(unsigned char id,int val) {
@@ -847,16 +971,292 @@ void edcConfSendStatus(unsigned char id,int val) {
 	edcConfSendMessage(buf1,buf2);
 }
 
+// Binary frame: <STX>key:<length><data bytes><0x1f><checksum><ETX>, data is little endian
+void edcConfSendBinary(const char *key,const unsigned char *data,unsigned char len) {
+	unsigned char checksum = 0;
+	uiSerial.write(0x02);
+	for (unsigned char i=0;i<strlen(key);i++) {
+		checksum = (checksum<<1) ^ key[i];
+		uiSerial.write(key[i]);
+	}
+	uiSerial.write(':');
+	uiSerial.write(len);
+	for (unsigned char i=0;i<len;i++) {
+		checksum = (checksum<<1) ^ data[i];
+		uiSerial.write(data[i]);
+	}
+	uiSerial.write(0x1f);
+	uiSerial.write(checksum);
+	uiSerial.write(0x03);
+}
+
+#ifdef TRACE
+// Trace dump is a sequence of binary "_TRC" frames (records, see Trace.h), ended by an empty frame
+void edcConfSendTraceBlock(const unsigned char *data,unsigned char len) {
+	edcConfSendBinary("_TRC",data,len);
+}
+#endif
+
+#ifdef TASK_STATS
+// Sends task statistics as binary "_TSK" frame, per task: id, calls, min, max, mean, max jitter, overruns
+// (id 8-bit, others 16-bit, times in us)
+void edcConfSendTaskStats() {
+	unsigned char buf[TASK_STATS_MAX*13];
+	unsigned char *p = buf;
+	taskStatsStruct stats;
+	for (unsigned char i=0;i<TASK_STATS_MAX;i++) {
+		taskStatsCopy(i,&stats);
+		unsigned int values[6] = {stats.calls,stats.calls ? stats.minTime : 0,stats.maxTime,
+			stats.calls ? (unsigned int)(stats.sumTime/stats.calls) : 0,stats.maxJitter,stats.overruns};
+		*p++ = i;
+		for (unsigned char j=0;j<6;j++) {
+			*p++ = values[j] & 0xff;
+			*p++ = values[j] >> 8;
+		}
+	}
+	edcConfSendBinary("_TSK",buf,sizeof(buf));
+}
+#endif
+
+#ifdef MAP_HEATMAP
+// Sends hit counters of map as "_HMP:<map index>,<sizeX>,<sizeY>,<counters as hex, row by row>"
+void edcConfSendHeatmap(unsigned char idx) {
+	char buf[12+2*64]; // maps up to 64 cells
+	if (idx >= core.numberOfMaps || !core.mapInfo[idx].heat)
+		return;
+	mapInfoStruct *map = &core.mapInfo[idx];
+	unsigned int cells = map->sizeX*map->sizeY;
+	if (cells > (sizeof(buf)-12)/2)
+		return;
+	sprintf(buf,"%d,%d,%d,",idx,map->sizeX,map->sizeY);
+	char *p = buf+strlen(buf);
+	for (unsigned int i=0;i<cells;i++) {
+		sprintf(p,"%02X",map->heat[i]);
+		p += 2;
+	}
+	edcConfSendMessage("_HMP",buf);
+}
+#endif
+
 int i;
 #define BUFFER_SIZE 64
 char buffer[BUFFER_SIZE];
 char lastKey;
+
+// Serial input is parsed a byte at a time as it arrives, loop() never waits for the rest of a sequence
+#define INPUT_STATE_KEY 0
+#define INPUT_STATE_ESC 1 // ESC received
+#define INPUT_STATE_CSI 2 // ESC [ received
+#define INPUT_STATE_FRAME 3 // STX received, collecting frame until ETX
+#define INPUT_FRAME_TIMEOUT 200 // ms, incomplete frame is dropped
+unsigned char inputState;
+unsigned long inputFrameStart; // now_us()
 long time;
 
 boolean confChanged = 0;
-char loopCount = 0;
 boolean ecdConfEnabled = 0;
 
+// Sends event as "_EVT:<type>,<code>,<value>,<time us>"
+void edcConfSendEvent(const eventStruct *event) {
+	char buf[32];
+	sprintf(buf,"%u,%u,%u,%lu",event->type,event->code,event->value,event->time);
+	edcConfSendMessage("_EVT",buf);
+}
+
+// Events posted by interrupt handlers
+void processEvents() {
+	static unsigned char dropped = 0;
+	eventStruct event;
+	while (eventTake(&event)) {
+		switch (event.type) {
+			case EVENT_DTC:
+				dtc.setError(event.code);
+				break;
+		}
+		if (ecdConfEnabled)
+			edcConfSendEvent(&event);
+	}
+	if (eventsDropped() != dropped) {
+		dropped = eventsDropped();
+		confeditor.setSystemStatusMessage("Event queue full");
+	}
+	dtc.publishStatus();
+}
+
+// Periodic main loop tasks, period in milliseconds (now_us() time base). Tasks are checked in
+// array order on every loop() pass, so lower index has precedence. A task which has fallen more
+// than one period behind is rescheduled from current time instead of running a burst of catch-up calls.
+// While UI output waits for room in serial transmit buffer, tasks without LOOP_TASK_OUTPUT are run
+// from the wait (runControlTasks), so UI redraws do not delay control. Those tasks must not touch UI
+// state (flashFetchBuffer, status message), DTC status message is published from loop().
+#define loopTaskMax 8
+#define LOOP_TASK_OUTPUT 1 // task writes to uiSerial
+
+struct loopTaskStruct {
+	void (*handler)();
+	unsigned int period;
+	unsigned long next; // now_us()
+	unsigned char stats; // TASK_STATS_* id
+	unsigned char flags;
+} loopTaskArray[loopTaskMax];
+
+void runLoopTasks(bool output) {
+	unsigned long now = now_us();
+	for (unsigned char i=0;i<loopTaskMax;i++) {
+		if (loopTaskArray[i].handler == NULL || (long)(now-loopTaskArray[i].next) < 0)
+			continue;
+		if (!output && (loopTaskArray[i].flags & LOOP_TASK_OUTPUT))
+			continue;
+		unsigned long period = loopTaskArray[i].period*1000UL;
+		loopTaskArray[i].next += period;
+		if ((long)(now-loopTaskArray[i].next) >= 0)
+			loopTaskArray[i].next = now+period;
+		TRACE_ENTER(TRACE_LOOP_TASK,i);
+		TASK_STATS_BEGIN(loopTaskArray[i].stats);
+		loopTaskArray[i].handler();
+		TASK_STATS_END(loopTaskArray[i].stats);
+		TRACE_LEAVE(TRACE_LOOP_TASK,i);
+		now = now_us();
+	}
+}
+
+// uiSerial wait hook
+void runControlTasks() {
+	static bool running = false;
+	if (running)
+		return;
+	running = true;
+	runLoopTasks(false);
+	running = false;
+}
+
+void addLoopTask(void (*handler)(),unsigned int period,unsigned char stats,unsigned char flags) {
+	for (unsigned char i=0;i<loopTaskMax;i++) {
+		if (loopTaskArray[i].handler == NULL) {
+			loopTaskArray[i].period = period;
+			loopTaskArray[i].stats = stats;
+			loopTaskArray[i].flags = flags;
+			taskStatsInit(stats,period*1000L);
+			loopTaskArray[i].next = now_us()+period*1000UL;
+			loopTaskArray[i].handler = handler;
+			return;
+		}
+	}
+}
+
+// 60Hz
+void doEngineControlTask() {
+	refreshSlowSensors();
+	// RPM x injected fuel maps (advance & turbo control) share axes, locate cell once per run
+	mapLocate(&core.mapInfo[Core::mapIdxTurboControlMap],
+		core.controls[Core::valueRPM8bit],
+		core.controls[Core::valueFuelAmount8bit],
+		&loadMapCell);
+	doBoostControl();
+	doTimingControl();
+}
+
+// 2Hz
+void doHalfSecondTask() {
+	if (halfSeconds<255) 
+		halfSeconds++;
+}
+
+// 1Hz
+void doSecondTask() {
+	// Log some "short term" differencies
+	unsigned int a=rpmMax;
+	unsigned int b=rpmMin;
+	core.controls[Core::valueEngineRPMMin]=rpmMin;
+	core.controls[Core::valueEngineRPMMax]=rpmMax;
+
+	core.controls[Core::valueEngineRPMJitter]=a-b;
+	core.controls[Core::valueEngineRPMErrors]=rpm.errorCount;		
+	cli();
+	rpmMin = 0xffff;
+	rpmMax = 0;
+	sei();
+
+	int ret = tempSensorBcoefficientCalc(
+		core.controls[Core::valueTempEngineRaw],
+		core.node[Core::nodeEngineTempSensorBcoefficient].value,
+		core.node[Core::nodeEngineTempSensorNResistance].value,
+		core.node[Core::nodeEngineTempSensorNTemp].value
+		);
+	core.controls[Core::valueTempEngine] = ret;
+
+	ret = tempSensorBcoefficientCalc(
+		core.controls[Core::valueTempFuelRaw],
+		core.node[Core::nodeFuelTempSensorBcoefficient].value,
+		core.node[Core::nodeFuelTempSensorNResistance].value,
+		core.node[Core::nodeFuelTempSensorNTemp].value
+		);
+	core.controls[Core::valueTempFuel] = ret;
+
+	ret = tempSensorBcoefficientCalc(
+		core.controls[Core::valueTempIntakeRaw],
+		core.node[Core::nodeIntakeTempSensorBcoefficient].value,
+		core.node[Core::nodeIntakeTempSensorNResistance].value,
+		core.node[Core::nodeIntakeTempSensorNTemp].value
+		);
+	core.controls[Core::valueTempIntake] = ret;				
+
+	core.controls[Core::valueStackMargin] = stackMargin();
+	core.controls[Core::valueHeapUsed] = heapUsed();
+	if (core.controls[Core::valueStackMargin] < MEMORY_MARGIN_MIN)
+		dtc.setError(DTC_MEMORY_LOW);
+
+#if defined(MAP_HEATMAP) && MAP_HEATMAP_DECAY_SECONDS
+	static unsigned char heatmapSeconds = 0;
+	if (++heatmapSeconds >= MAP_HEATMAP_DECAY_SECONDS) {
+		heatmapSeconds = 0;
+		core.decayHeatmaps();
+	}
+#endif
+}
+
+// 20Hz, status stream for EDC Configurator
+void doEdcConfTask() {
+	if (!ecdConfEnabled)
+		return;
+	core.takeControlsSnapshot();
+	edcConfSendStatus(EDCCONF_RPM,core.controlsSnapshot[Core::valueEngineRPM]);
+	edcConfSendStatus(EDCCONF_TPS,core.controlsSnapshot[Core::valueTPSActual]);
+	edcConfSendStatus(EDCCONF_QA_SETPOINT,core.controlsSnapshot[Core::valueQAfeedbackSetpoint]);
+	edcConfSendStatus(EDCCONF_QA_ACTUAL,core.controlsSnapshot[Core::valueQAfeedbackActual]);
+	edcConfSendStatus(EDCCONF_MAP_SETPOINT,core.controlsSnapshot[Core::valueBoostPressure]);
+	edcConfSendStatus(EDCCONF_MAP_ACTUAL,core.controlsSnapshot[Core::valueBoostTarget]);		
+	edcConfSendStatus(EDCCONF_QA_PID_P,adjuster.p);
+	edcConfSendStatus(EDCCONF_QA_PID_P,adjuster.i);
+	edcConfSendStatus(EDCCONF_QA_PID_P,adjuster.d);
+
+	edcConfSendStatus(EDCCONF_TEMP_COOLANT,core.controlsSnapshot[Core::valueTempEngine]);
+	edcConfSendStatus(EDCCONF_TEMP_INTAKE,core.controlsSnapshot[Core::valueTempIntake]);
+	edcConfSendStatus(EDCCONF_TEMP_FUEL,core.controlsSnapshot[Core::valueTempFuel]);
+	edcConfSendStatus(EDCCONF_STACK_MARGIN,core.controlsSnapshot[Core::valueStackMargin]);
+	edcConfSendStatus(EDCCONF_MAP_ARENA_USED,core.mapArenaUsed);
+}
+
+// 60Hz
+void doUserInterfaceTask() {
+	static int debug;
+	debug = !debug;
+	digitalWrite(13,debug);
+	confeditor.refresh();
+}
+
+void setupLoopTasks() {
+	// in order of precedence
+	addLoopTask(doEngineControlTask,16,TASK_STATS_LOOP_ENGINE,0);
+	addLoopTask(doIdlePidControl,33,TASK_STATS_LOOP_IDLE,0);
+	addLoopTask(doRelayControl,33,TASK_STATS_LOOP_RELAY,0);
+	addLoopTask(doHalfSecondTask,500,TASK_STATS_LOOP_HALF_SECOND,0);
+	addLoopTask(doSecondTask,1000,TASK_STATS_LOOP_SECOND,0);
+	addLoopTask(doEdcConfTask,50,TASK_STATS_LOOP_EDCCONF,LOOP_TASK_OUTPUT);
+	addLoopTask(doUserInterfaceTask,16,TASK_STATS_LOOP_UI,LOOP_TASK_OUTPUT);
+	uiSerial.waitHook = runControlTasks;
+}
+
 void setup_old2() {
 	Serial.begin(115200);
 	Serial.write(0x02);
@@ -868,171 +1268,113 @@ void setup_old2() {
 void loop_old2() {
 	edcConfSendStatus(42,6666);
 }
-void loop() {
-	boolean ignoreSleep = false;
-
-	// test only
-	// refreshFastSensors();
-	
-	refreshSlowSensors();
-	doBoostControl();
-	doTimingControl();
 
-//	static int rpmMin,rpmMax;
-	if (loopCount % 30 == 0) {	
-		if (halfSeconds<255) 
-			halfSeconds++;
+// Command frame from EDC Configurator, <STX>command<ETX>
+void handleFrame() {
+#ifdef MAP_HEATMAP
+	if (strncmp(buffer,"_HMP",4) == 0) {
+		// Heatmap query, "_HMP<map index>"
+		edcConfSendHeatmap(atoi(buffer+4));
 	}
-	if (loopCount % 2 == 0) {
-		doIdlePidControl();
+#endif
+#ifdef TRACE
+	if (strcmp(buffer,"_TRC") == 0) {
+		traceDump(edcConfSendTraceBlock);
 	}
-	
-	if (loopCount % 2 == 0) {
-		doRelayControl();
+#endif
+#ifdef TASK_STATS
+	if (strcmp(buffer,"_TSK") == 0) {
+		// Task statistics query, "_TSR" also resets them
+		edcConfSendTaskStats();
+	} else if (strcmp(buffer,"_TSR") == 0) {
+		edcConfSendTaskStats();
+		taskStatsReset();
 	}
-	if (loopCount == 60) {
-		// Log some "short term" differencies
-		unsigned int a=rpmMax;
-		unsigned int b=rpmMin;
-		core.controls[Core::valueEngineRPMMin]=rpmMin;
-		core.controls[Core::valueEngineRPMMax]=rpmMax;
-
-		core.controls[Core::valueEngineRPMJitter]=a-b;
-		core.controls[Core::valueEngineRPMErrors]=rpm.errorCount;		
-		cli();
-		rpmMin = 0xffff;
-		rpmMax = 0;
-		sei();
-		loopCount=0;    
-
-		int ret = tempSensorBcoefficientCalc(
-			core.controls[Core::valueTempEngineRaw],
-			core.node[Core::nodeEngineTempSensorBcoefficient].value,
-			core.node[Core::nodeEngineTempSensorNResistance].value,
-			core.node[Core::nodeEngineTempSensorNTemp].value
-			);
-		core.controls[Core::valueTempEngine] = ret;
-
-		ret = tempSensorBcoefficientCalc(
-			core.controls[Core::valueTempFuelRaw],
-			core.node[Core::nodeFuelTempSensorBcoefficient].value,
-			core.node[Core::nodeFuelTempSensorNResistance].value,
-			core.node[Core::nodeFuelTempSensorNTemp].value
-			);
-		core.controls[Core::valueTempFuel] = ret;
-
-		ret = tempSensorBcoefficientCalc(
-			core.controls[Core::valueTempIntakeRaw],
-			core.node[Core::nodeIntakeTempSensorBcoefficient].value,
-			core.node[Core::nodeIntakeTempSensorNResistance].value,
-			core.node[Core::nodeIntakeTempSensorNTemp].value
-			);
-		core.controls[Core::valueTempIntake] = ret;				
-	}  
-/*	if (core.controls[Core::valueEngineRPM]<rpmMin) 
-		rpmMin = core.controls[Core::valueEngineRPM];
-	if (core.controls[Core::valueEngineRPM]>rpmMax) 
-		rpmMax = core.controls[Core::valueEngineRPM];
-*/
-	
-	loopCount++;
-	
-	lastKey = 0;
-	// Read incoming command from serial interface (USB)
-	if (Serial.available()>0) {
-		char c = Serial.read();
-		if (c == 27) {
-			c = Serial.read();
-			if (c == '[') {
-				c = Serial.read();
-				// Cursor to "vi" nodes
-				switch (c) { 
-					case 'A':
-					lastKey = KEY_UP;
-					break;
-					case 'B':
-					lastKey = KEY_DOWN;
-					break;
-					case 'C':
-					lastKey = KEY_RIGHT;
-					break;
-					case 'D':
-					lastKey = KEY_LEFT;
-					break;
-			}
-			}
-			confeditor.handleInput(lastKey);
-			} else {
-			// Special commands
-				switch (c) {
-				case ',':
-					qaTemporaryDisabled = !qaTemporaryDisabled;
-					confeditor.setSystemStatusMessage(qaTemporaryDisabled?"QA Disable":"QA Normal");
-					break;
-				case ';':
-					qaFollowsTPS = !qaFollowsTPS;
-					confeditor.setSystemStatusMessage(qaFollowsTPS?"QaPos=TPS":"QaPOS=Map");
-					break;
-						
-                case 2: // STX
-					while (1) {
-						
-						if (Serial.available()) {
-							c = Serial.read();
-							if (c==3) // ETX
-								break;
-							if (i<BUFFER_SIZE-1) {
-								buffer[i]=c;
-								i++;
-							}
-						}
-					}
-					buffer[i]=0;
-					buffer[4]=0;					
-					if (strcmp(buffer,"_INI") == 0) {
-						// EDC Configurator enabled
-						ecdConfEnabled = true;
-						edcConfSendMessage("_RDY","dmn-edc 1.0");
-						Serial.print("edcConf enabled");						
-					}
+#endif
+	buffer[4]=0;
+	if (strcmp(buffer,"_INI") == 0) {
+		// EDC Configurator enabled
+		ecdConfEnabled = true;
+		edcConfSendMessage("_RDY","dmn-edc 1.0");
+		uiSerial.print("edcConf enabled");
+	}
+}
 
+void handleKey(char c) {
+	switch (inputState) {
+		case INPUT_STATE_ESC:
+			inputState = c == '[' ? INPUT_STATE_CSI : INPUT_STATE_KEY;
+			if (inputState == INPUT_STATE_KEY)
+				confeditor.handleInput(0);
+			return;
+		case INPUT_STATE_CSI:
+			inputState = INPUT_STATE_KEY;
+			lastKey = 0;
+			// Cursor to "vi" nodes
+			switch (c) { 
+				case 'A':
+				lastKey = KEY_UP;
+				break;
+				case 'B':
+				lastKey = KEY_DOWN;
+				break;
+				case 'C':
+				lastKey = KEY_RIGHT;
+				break;
+				case 'D':
+				lastKey = KEY_LEFT;
 				break;
-				default:
-					confeditor.handleInput(c);
 			}
-		}
+			confeditor.handleInput(lastKey);
+			return;
 	}
+	// Special commands
+	switch (c) {
+		case 27:
+			inputState = INPUT_STATE_ESC;
+			break;
+		case ',':
+			qaTemporaryDisabled = !qaTemporaryDisabled;
+			confeditor.setSystemStatusMessage(qaTemporaryDisabled?"QA Disable":"QA Normal");
+			break;
+		case ';':
+			qaFollowsTPS = !qaFollowsTPS;
+			confeditor.setSystemStatusMessage(qaFollowsTPS?"QaPos=TPS":"QaPOS=Map");
+			break;
+		case 2: // STX
+			i = 0;
+			inputState = INPUT_STATE_FRAME;
+			inputFrameStart = now_us();
+			break;
+		default:
+			confeditor.handleInput(c);
+	}
+}
 
-	if (ecdConfEnabled) {
-		unsigned long int l = millis();
-		l += 16;
-		do { 
-			
-			edcConfSendStatus(EDCCONF_RPM,core.controls[Core::valueEngineRPM]);
-			edcConfSendStatus(EDCCONF_TPS,core.controls[Core::valueTPSActual]);
-			edcConfSendStatus(EDCCONF_QA_SETPOINT,core.controls[Core::valueQAfeedbackSetpoint]);
-			edcConfSendStatus(EDCCONF_QA_ACTUAL,core.controls[Core::valueQAfeedbackActual]);
-			edcConfSendStatus(EDCCONF_MAP_SETPOINT,core.controls[Core::valueBoostPressure]);
-			edcConfSendStatus(EDCCONF_MAP_ACTUAL,core.controls[Core::valueBoostTarget]);		
-			edcConfSendStatus(EDCCONF_QA_PID_P,adjuster.p);
-			edcConfSendStatus(EDCCONF_QA_PID_P,adjuster.i);
-			edcConfSendStatus(EDCCONF_QA_PID_P,adjuster.d);
-
-			edcConfSendStatus(EDCCONF_TEMP_COOLANT,core.controls[Core::valueTempEngine]);
-			edcConfSendStatus(EDCCONF_TEMP_INTAKE,core.controls[Core::valueTempIntake]);
-			edcConfSendStatus(EDCCONF_TEMP_FUEL,core.controls[Core::valueTempFuel]);
-			
-			//edcConfSendStatus(42,6666);
-			
-		} while (millis() <= l);
-		
-	} else {
-		delay(1000/60);
+void loop() {
+	processEvents();
+	runLoopTasks(true);
+
+	// Read incoming command from serial interface (USB), frame bytes as far as received, else one key per pass
+	if (inputState == INPUT_STATE_FRAME && now_us()-inputFrameStart > INPUT_FRAME_TIMEOUT*1000UL)
+		inputState = INPUT_STATE_KEY;
+	while (Serial.available()>0) {
+		char c = Serial.read();
+		if (inputState != INPUT_STATE_FRAME) {
+			handleKey(c);
+			break;
+		}
+		if (c == 3) { // ETX
+			buffer[i] = 0;
+			inputState = INPUT_STATE_KEY;
+			handleFrame();
+			break;
+		}
+		if (i<BUFFER_SIZE-1) {
+			buffer[i] = c;
+			i++;
+		}
 	}
-	static int debug;
-	debug = !debug;
-	digitalWrite(13,debug);
-	confeditor.refresh();
 
 
 	// Handle errors (generated by interrupt service)
@@ -0,0 +1,44 @@
+#include "EventQueue.h"
+#include "TimeBase.h"
+
+static volatile eventStruct eventQueue[EVENT_QUEUE_SIZE];
+static volatile unsigned char eventHead; // next free, moved by eventPost
+static volatile unsigned char eventTail; // oldest, moved by eventTake
+static volatile unsigned char eventDropCount;
+
+bool eventPost(unsigned char type,unsigned char code,unsigned int value) {
+	unsigned char oldSREG = SREG;
+	cli();
+	unsigned char head = eventHead;
+	if (((head+1) & (EVENT_QUEUE_SIZE-1)) == eventTail) {
+		if (eventDropCount<255)
+			eventDropCount++;
+		SREG = oldSREG;
+		return false;
+	}
+	volatile eventStruct *e = &eventQueue[head];
+	e->time = now_us();
+	e->value = value;
+	e->type = type;
+	e->code = code;
+	eventHead = (head+1) & (EVENT_QUEUE_SIZE-1);
+	SREG = oldSREG;
+	return true;
+}
+
+bool eventTake(eventStruct *event) {
+	unsigned char tail = eventTail;
+	if (tail == eventHead)
+		return false;
+	volatile eventStruct *e = &eventQueue[tail];
+	event->time = e->time;
+	event->value = e->value;
+	event->type = e->type;
+	event->code = e->code;
+	eventTail = (tail+1) & (EVENT_QUEUE_SIZE-1);
+	return true;
+}
+
+unsigned char eventsDropped() {
+	return eventDropCount;
+}
@@ -0,0 +1,31 @@
+#ifndef EVENTQUEUE_H
+#define EVENTQUEUE_H
+
+#include "Arduino.h"
+
+/*
+	Interrupt handler to main loop event queue. Interrupt handlers post compact event records
+	(no string handling or EEPROM access in interrupt context), main loop takes them and passes
+	them to DTC memory, UI and edcConf stream.
+
+	Ring of EVENT_QUEUE_SIZE records. Posting is serialized by a short interrupt lock (handlers can
+	be nested), taking is lock free as only main loop moves the tail. A full queue drops the new
+	event and counts it.
+*/
+
+#define EVENT_QUEUE_SIZE 16 /* power of two */
+
+#define EVENT_DTC 1 /* code = DTC number */
+
+struct eventStruct {
+	unsigned long time; // now_us()
+	unsigned int value;
+	unsigned char type;
+	unsigned char code;
+};
+
+bool eventPost(unsigned char type,unsigned char code,unsigned int value=0);
+bool eventTake(eventStruct *event); // main loop only
+unsigned char eventsDropped();
+
+#endif
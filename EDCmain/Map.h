@@ -0,0 +1,110 @@
+#ifndef MAP_H
+#define MAP_H
+
+#include "defines.h"
+
+/*
+    Map data layout (byte blob, see Core.cpp for the default maps)
+
+    header   <map-id>, 0xf0, 'M', <dimensions '1'/'2'>, <format>, sizeX, sizeY, axisTypeX, axisTypeY, axisTypeResult
+    axis     sizeX+sizeY breakpoints ('B' and 'W' formats only)
+    cells    sizeX*sizeY bytes, or 16-bit words for 'W' format
+    trailer  reserved, first MAP_TRAILER_SAVED bytes are stored to EEPROM
+*/
+#define MAP_OFS_FORMAT 4
+#define MAP_OFS_SIZE_X 5
+#define MAP_OFS_SIZE_Y 6
+#define MAP_OFS_AXIS_TYPE_X 7
+#define MAP_OFS_AXIS_TYPE_Y 8
+#define MAP_OFS_AXIS_TYPE_RESULT 9
+#define MAP_HEADER_SIZE 10
+#define MAP_TRAILER_SIZE 7
+#define MAP_TRAILER_SAVED 5
+
+// Map type, layout of the blob is known at compile time. Runtime code (lookups, editor, EEPROM) 
+// uses the type-erased mapInfoStruct view prepared from the blob header.
+template <unsigned char SizeX,unsigned char SizeY,unsigned char AxisTypeX,unsigned char AxisTypeY,unsigned char AxisTypeResult,char Format>
+struct Map {
+    static_assert(SizeX>1 && SizeY>0,"map needs at least 2 cells in x direction");
+    static_assert(Format == 'D' || Format == 'B' || Format == 'W',"unknown map format");
+    static_assert(SizeY>1 || AxisTypeY == MAP_AXIS_NONE,"1D map can not have y axis");
+
+    static const unsigned char sizeX = SizeX;
+    static const unsigned char sizeY = SizeY;
+    static const unsigned char axisTypeX = AxisTypeX;
+    static const unsigned char axisTypeY = AxisTypeY;
+    static const unsigned char axisTypeResult = AxisTypeResult;
+    static const char format = Format;
+    static const char dimensions = SizeY>1 ? '2' : '1';
+    static const bool wide = (Format == 'W');
+
+    static const unsigned int axisOffset = MAP_HEADER_SIZE;
+    static const unsigned int cellOffset = axisOffset+((Format == 'B' || Format == 'W') ? SizeX+SizeY : 0);
+    static const unsigned int cellSize = SizeX*SizeY*(wide ? 2 : 1);
+    static const unsigned int size = cellOffset+cellSize+MAP_TRAILER_SIZE; // blob size
+    static const unsigned int dataSize = size-MAP_TRAILER_SIZE+MAP_TRAILER_SAVED; // EEPROM chunk size, see mapDataSize()
+};
+
+// Blob sizes of a set of map types, for sizing map RAM at compile time
+template <class... M>
+struct MapSet {
+    static const unsigned int size = 0; // sum of blob sizes
+    static const unsigned int largest = 0;
+};
+template <class M,class... Rest>
+struct MapSet<M,Rest...> {
+    static const unsigned int size = M::size+MapSet<Rest...>::size;
+    static const unsigned int largest = M::size > MapSet<Rest...>::largest ? M::size : MapSet<Rest...>::largest;
+};
+
+// Header bytes of given map type
+#define MAP_HEADER(id,type) (id),0xF0,'M',type::dimensions,type::format,type::sizeX,type::sizeY,type::axisTypeX,type::axisTypeY,type::axisTypeResult
+#define MAP_TRAILER 0,0,0,0,0,1,1
+// Fails compile if map data does not match its type
+#define MAP_CHECK(map,type) static_assert(sizeof(map) == type::size,#map " size does not match map type")
+
+// Last operating point of a map, updated by lookups for map editor live view
+struct mapTelemetryStruct {
+    unsigned char lastX;
+    unsigned char lastY;
+    unsigned int lastRet; // 8.8 fixed point, cell value for 'W' maps
+    unsigned char idxX; // nearest cell (1..size)
+    unsigned char idxY;
+};
+
+// Lookup parameters of a map, cached by mapPrepare() when map is initialized or loaded.
+// Map data itself is never written by lookups, read it with mapDataByte() as it may be in flash.
+struct mapInfoStruct {
+    const unsigned char *data; // map data (header, axis breakpoints, cells)
+    const unsigned char *cells;
+    const unsigned char *axisX; // breakpoints, NULL if evenly distributed
+    const unsigned char *axisY;
+    unsigned int scaleX; // input to cell position scale, 8.8 fixed point
+    unsigned int scaleY;
+    unsigned char sizeX;
+    unsigned char sizeY;
+    mutable unsigned char hintX; // last used cell, only a start point for breakpoint search
+    mutable unsigned char hintY;
+    bool interpolated;
+    bool wide; // 'W' format, 16-bit cells
+    bool flash; // data is flash resident default map (PROGMEM)
+    unsigned char axesId; // maps with identical axes have same id
+    mapTelemetryStruct * volatile telemetry; // NULL unless map is shown in editor
+#ifdef MAP_HEATMAP
+    unsigned char *heat; // saturating hit counter per cell, NULL if map has no heatmap
+    mutable unsigned char heatTick; // lookup prescaler
+#endif
+};
+
+// Cell position of an input pair (see mapLocate), can be shared by maps with same axesId
+struct mapCellStruct {
+    unsigned char axesId;
+    unsigned char x;
+    unsigned char y;
+    unsigned char xPos;
+    unsigned char yPos;
+    unsigned char fracX;
+    unsigned char fracY;
+};
+
+#endif
@@ -34,6 +34,35 @@ int freeListSize() {
     return total;
 }
 
+#define MEMORY_CANARY 0xa5
+
+static unsigned char *stackLowMark; // deepest stack position seen (lowest address)
+
+static unsigned char *heapEnd() {
+    return (unsigned char*)(__brkval ? __brkval : &__heap_start);
+}
+
+void paintFreeMemory() {
+    unsigned char *p = heapEnd();
+    unsigned char *end = (unsigned char*)SP - 16; // leave room for this call
+    stackLowMark = end;
+    while (p < end)
+        *p++ = MEMORY_CANARY;
+}
+
+/* Scans from heap end up to previous low mark, so cost is bounded by the margin itself */
+int stackMargin() {
+    unsigned char *p = heapEnd();
+    while (p < stackLowMark && *p == MEMORY_CANARY)
+        p++;
+    stackLowMark = p;
+    return (int)(p - heapEnd());
+}
+
+int heapUsed() {
+    return __brkval ? (int)__brkval - (int)&__heap_start : 0;
+}
+
 int freeMemory() {
     int free_memory;
     
@@ -12,6 +12,12 @@ extern "C" {
     
     int freeMemory();
     
+    // Stack high-water monitoring: free RAM between heap and stack is filled with canary
+    // pattern at startup, stackMargin() returns the smallest gap (bytes) seen since then.
+    void paintFreeMemory();
+    int stackMargin();
+    int heapUsed();
+    
 #ifdef  __cplusplus
 }
 #endif
@@ -4,6 +4,7 @@
 #include "TimerThree.h"
 #include "utils.h"
 #include "DTC.h"
+#include "EventQueue.h"
 #include "BackgroundADC.h"
 
 QuantityAdjuster::QuantityAdjuster() {
@@ -14,6 +15,7 @@ void QuantityAdjuster::initialize() {
 	Timer3.start();
 	errorOld=0;
 	integral=0;
+	resetRequest=0;
 	setPoint = 42;
 	speed=1;
 }
@@ -21,12 +23,11 @@ void QuantityAdjuster::initialize() {
 static char qaCalls=0;
 
 void QuantityAdjuster::reset() {
-	integral=0;
-	error=0;
+	resetRequest = 1; // done by update()
 }
 void QuantityAdjuster::update(char skip) {
 	if (qaCalls)
-		dtc.setError(DTC_TRAP_1);
+		eventPost(EVENT_DTC,DTC_TRAP_1);
 
 	qaCalls++;
 
@@ -37,14 +38,34 @@ void QuantityAdjuster::update(char skip) {
 	Kd = (float)(core.node[Core::nodeQAPIDKd].value)/256;
 	speed = (core.node[Core::nodeQAPIDSpeed].value);
 
-	if (setPoint < targetSetPoint) {
+	// Take the handed over setpoint and reset request once, setPosition() may run (from crank
+	// angle task) while this update is in progress
+	unsigned char oldSREG = SREG;
+	cli();
+	int target = targetSetPoint;
+	char resetNow = resetRequest;
+	resetRequest = 0;
+	SREG = oldSREG;
+
+	if (resetNow) {
+		integral=0;
+		error=0;
+	}
+	if (target > setPointMax)
+		setPointMax=target;
+	if (target < setPointMin)
+		setPointMin=target;
+
+	if (target == 0) {
+		setPoint = 0;
+	} else if (setPoint < target) {
 		setPoint += speed;
-		if (setPoint > targetSetPoint)
-			setPoint = targetSetPoint;
-	} else if (setPoint > targetSetPoint) {
+		if (setPoint > target)
+			setPoint = target;
+	} else if (setPoint > target) {
 		setPoint -= speed;
-		if (setPoint < targetSetPoint)
-			setPoint = targetSetPoint;
+		if (setPoint < target)
+			setPoint = target;
 	}
 
 	core.controls[Core::valueQAfeedbackSetpoint] = setPoint; 
@@ -138,22 +159,14 @@ void QuantityAdjuster::update(char skip) {
 	qaCalls--;
 }
 
- void QuantityAdjuster::setPosition(int val) {
- 	if (val > setPointMax)
- 		setPointMax=val;
- 	if (val < setPointMin)
- 		setPointMin=val;
-
- 	cli();
+// Hands the setpoint over to update(), which does the ramp. Single guarded store so this can
+// be called from any interrupt context.
+void QuantityAdjuster::setPosition(int val) {
+	unsigned char oldSREG = SREG;
+	cli();
 	core.node[Core::nodeQASetPoint].value = val;
-	sei();
-	
-	if (val == 0) {
-		targetSetPoint = 0;
-		setPoint = 0;
-	} else {
-		targetSetPoint = val;
-	}
+	targetSetPoint = val;
+	SREG = oldSREG;
 }
 
 void QuantityAdjuster::triggerHit() {
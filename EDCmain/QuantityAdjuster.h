@@ -17,7 +17,8 @@ private:
     float errorOld;
     float derivate;
     volatile char statusBits;
-    volatile int targetSetPoint; 
+    volatile int targetSetPoint; // written by setPosition(), consumed by update()
+    volatile char resetRequest;
     volatile int setPoint;
     unsigned int speed;
 
@@ -1,6 +1,59 @@
 #include "RPMBase.h"
 #include "core.h"
 
+volatile long rpmMax;
+volatile long rpmMin;
+
+/*
+ *  Reciprocal table: 2*K/m for m = 128..256, K = timer ticks per minute / marks per revolution.
+ *  Ticks are normalized to 1mmmmmmm.ffffffff (16 bits), table is interpolated with the fraction
+ *  and result scaled back with the normalization shift. Error is below 1 RPM up to 7500rpm.
+ */
+#define RPM_RECIPROCAL_K (RPMTIMER_TICKS_PER_MINUTE/NUMBER_OF_CYLINDERS)
+#define RPM_RECIPROCAL(m) (unsigned int)((RPM_RECIPROCAL_K*2+(m)/2)/(m))
+#define RPM_RECIPROCAL8(m) RPM_RECIPROCAL(m),RPM_RECIPROCAL(m+1),RPM_RECIPROCAL(m+2),RPM_RECIPROCAL(m+3), \
+	RPM_RECIPROCAL(m+4),RPM_RECIPROCAL(m+5),RPM_RECIPROCAL(m+6),RPM_RECIPROCAL(m+7)
+
+#if RPM_RECIPROCAL_K*2/128 > 65535
+#error "RPM reciprocal table does not fit 16 bits, too few marks per revolution"
+#endif
+
+static const unsigned int rpmReciprocalTable[129] PROGMEM = {
+	RPM_RECIPROCAL8(128),RPM_RECIPROCAL8(136),RPM_RECIPROCAL8(144),RPM_RECIPROCAL8(152),
+	RPM_RECIPROCAL8(160),RPM_RECIPROCAL8(168),RPM_RECIPROCAL8(176),RPM_RECIPROCAL8(184),
+	RPM_RECIPROCAL8(192),RPM_RECIPROCAL8(200),RPM_RECIPROCAL8(208),RPM_RECIPROCAL8(216),
+	RPM_RECIPROCAL8(224),RPM_RECIPROCAL8(232),RPM_RECIPROCAL8(240),RPM_RECIPROCAL8(248),
+	RPM_RECIPROCAL(256)
+};
+
+unsigned int rpmFromTicks(unsigned long ticks,unsigned char marks) {
+	if (!ticks)
+		return 0;
+	signed char shift = 0;
+	while (ticks > 0xffff) {
+		ticks >>= 1;
+		shift--;
+	}
+	unsigned int n = ticks;
+	while (!(n & 0x8000)) {
+		n <<= 1;
+		shift++;
+	}
+	const unsigned int *p = rpmReciprocalTable+((n>>8)-128);
+	unsigned int r1 = pgm_read_word(p);
+	unsigned int r2 = pgm_read_word(p+1);
+	unsigned long ret = (unsigned long)(r1-((unsigned long)(r1-r2)*(n&0xff)>>8))*marks;
+	// K/ticks = r*2^shift/512
+	if (shift >= 9) {
+		ret <<= shift-9;
+	} else {
+		ret = (ret+(1ul<<(8-shift)))>>(9-shift);
+	}
+	if (ret > 0xffff)
+		return 0xffff;
+	return ret;
+}
+
 RPMBase::RPMBase()  {
 	errorCount=0;	
 }
@@ -16,6 +69,14 @@ unsigned int RPMBase::getLatestRawValue() {
 int RPMBase::getInjectionTiming() {
 	return 0;
 }
+unsigned long RPMBase::getLastMarkTime() {
+	return 0;
+}
+bool RPMBase::addCrankTask(void (*)(),unsigned int,unsigned char) {
+	return false;
+}
+void RPMBase::holdCrankTasks(bool) {
+}
 
 void RPMBase::measure() {
 	cli();
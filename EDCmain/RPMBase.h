@@ -15,9 +15,23 @@ class RPMBase {
 	virtual unsigned int getLatestRawValue();
 	virtual int getInjectionTiming();
 	virtual unsigned int getDeviationForCylinder(unsigned char cyl);
+	virtual unsigned long getLastMarkTime(); // now_us() of latest accepted flywheel mark
+	// Run handler at angle (0.1°) after each flywheel mark, returns false if not supported
+	virtual bool addCrankTask(void (*handler)(),unsigned int angle,unsigned char stats);
+	// Keep crank tasks from starting (due one runs on release), interrupt context with interrupts disabled
+	virtual void holdCrankTasks(bool hold);
 	
 	void measure();
 	unsigned char getError();
 	//void fullRotationTrigger();
 };
+
+#define RPMTIMER_TICKS_PER_MINUTE (60*F_CPU/64) // 250kHz timer
+
+// Timer ticks (250kHz) to RPM, ticks = sum of 'marks' durations of 1/NUMBER_OF_CYLINDERS revolution.
+// Reciprocal table lookup, no division.
+unsigned int rpmFromTicks(unsigned long ticks,unsigned char marks);
+
+extern volatile long rpmMax; // shortest & longest mark duration, timer ticks
+extern volatile long rpmMin;
 #endif
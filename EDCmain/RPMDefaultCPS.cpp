@@ -1,5 +1,13 @@
 #include "RPMDefaultCPS.h"
 #include "BackgroundADC.h"
+#include "TaskStats.h"
+#include "TimeBase.h"
+#include "Trace.h"
+#include "RPMTimer.h"
+#include "AngleClock.h"
+#include "CylinderPhase.h"
+
+#ifndef RPM_SENSOR_TYPE_TOOTH_WHEEL
 
 /* 
  *  Some low level functions for RPM counting (and also for injection timing measurement) 
@@ -7,97 +15,161 @@
  *  Timer 1 frequency (250KHz) is optimized for 4 ... 6 marks on flywheel (same as number of cylinders, usually) 
  *  Minimum rotating speed detected is about 57RPM (4cyl engine)
  *  
- *  Timer 1 is set to 0 when RPM interrupt happens and old Timer 1 value is stored. 
- *  This value can be directly converted for revolutions per minute. 
- *  If timer reaches 65535, overflow interrupt handler is activated and it engine is 
- *  declared as stopped.
+ *  Timer 1 runs free (never reset or stopped). Each mark stores the counter value as timestamp and 
+ *  mark to mark duration is the difference of two timestamps, which can be directly converted for 
+ *  revolutions per minute. Compare A is set to 65535 ticks after the latest mark, if it 
+ *  matches (no mark during a full counter round) engine is declared as stopped.
  *  
  *  Injection timing is also recorded. Because the mark on the flywheel is on a known position, the
  *  counter value can be converted to actual degree of advance/retard
  *  
+ *  With RPM_INPUT_CAPTURE, Timer 5 is used instead and the crank sensor is wired to ICP5 (pin 48). 
+ *  Edge time is latched by hardware (with noise canceler), so timestamp does not depend on interrupt 
+ *  latency. Otherwise INT0 (pin 2) is used and counter is read in the handler.
+ *  
+ *  Noise rejection: an edge closer than RPM_NOISE_WINDOW to the previous accepted mark is ignored.
+ *  Window is a fraction of the latest mark to mark duration (RPMTIMER_MIN_DURATON after stop).
  *  
+ *  Angle clock (AngleClock.h) is fed on every mark once cylinder phase is known, angle 0 is the mark
+ *  of NEEDLELIFTSENSOR_CYLINDER. Marks are identical, so before that the angle is not known at all.
+ *  
+ *  Cylinder phase (CylinderPhase.h): measurements[] index is the slot, needle lift pulse tells the 
+ *  slot after the mark of NEEDLELIFTSENSOR_CYLINDER. Time from that mark to needle lift is the 
+ *  injection timing.
 */
 
-
-static volatile unsigned int injectionBegin;
-// record rotation speeds for a full engine cycle (720°)
+static volatile unsigned char injectionBegin; // valueEngineTimingDiff is valid
+static volatile unsigned char needleSeen; // needle lift pulse in current mark interval
+// record rotation speeds for a full engine cycle (720°), index is cylinder phase slot
 volatile unsigned int measurements[NUMBER_OF_CYLINDERS*2]; 
 unsigned char currentTick;
+static volatile unsigned long measurementsSum; // latest NUMBER_OF_CYLINDERS measurements (one revolution)
 
 volatile unsigned int rpmDuration;
+static volatile unsigned long rpmMarkTime; // now_us()
 
 extern volatile unsigned int intHandlerCalls;
 
+/*
+ *  Crank angle tasks: rpmMark arms compare B to the angle of first task, compare B interrupt 
+ *  runs tasks one by one (with interrupts enabled) and arms the next one. Angle is converted to timer 
+ *  ticks using the latest mark to mark duration. A task that is still running when its next turn comes 
+ *  is skipped (counted as overrun in task statistics). Timer3 holds crank tasks while its priority 0
+ *  handlers (QA servo) run, a task that comes due meanwhile starts on release (compare flag stays set).
+ */
+#define CRANK_TASK_MAX 4
+
+static struct crankTaskStruct {
+	void (*handler)();
+	unsigned int angle; // 0.1°, after flywheel mark
+	unsigned char stats;
+} crankTasks[CRANK_TASK_MAX];
+
+static unsigned char crankTaskCount;
+static volatile unsigned char crankTaskNext; // next task in current mark interval
+static volatile unsigned char crankTaskBusy;
+static volatile unsigned char crankTaskArmed; // compare B set for crankTaskNext
+static volatile unsigned char crankTaskHeld;
+static volatile unsigned char crankTaskMark; // incremented on every mark
+static volatile unsigned int crankTaskDuration; // mark to mark, timer ticks
+
+static volatile unsigned int rpmMarkTicks; // timer timestamp of latest accepted mark
+static unsigned char rpmMarkIndex; // angle clock position, 0 = first mark after start
+static volatile unsigned char rpmStopped = 1; // no valid previous mark
+
 static inline void rpmTimerSetup() __attribute__((always_inline));
-static inline void rpmTimerEnable() __attribute__((always_inline));
-static inline void rpmTimerDisable() __attribute__((always_inline));
-void rpmTrigger();
 
 static inline void rpmTimerSetup()  {
 	cli();
-	TCCR1A = 0; 
-	TCCR1B = 0; 
-	TCNT1 = 0;
-	OCR1A = 0xffff;
-
- 	TIMSK1 |= (1 << OCIE1A); // enable timer compare interrupt
+	RPM_TCCRA = 0; 
+	RPM_TCCRB = 3; // normal mode (free running), CS11 = 2+CS10 = 1 - 250kHz
+	RPM_OCRA = RPM_TCNT-1;
+	RPM_TIFR = (1 << RPM_OCFA);
+ 	RPM_TIMSK |= (1 << RPM_OCIEA); // enable timer compare interrupt
+	rpmInputEnable();
 	sei();
-	//attachInterrupt(0, rpmTrigger, RISING);  // Interrupt 0 -- PIN2 -- LM1815 gated output 
-	
-	
-	attachInterrupt(0, rpmTrigger, FALLING);  // Interrupt 0 -- PIN2 -- Cherry GS sensor 
-
  }
 
- static inline void rpmTimerEnable() {
- 	TCNT1 = 0;
- 	TCCR1B = 11; // WGM12 = 8 +CS11 = 2+CS10 = 1
- }
+// Call with interrupts disabled
+static void crankTaskArm() {
+	unsigned int ticks = ((unsigned long)crankTasks[crankTaskNext].angle*crankTaskDuration)/(FLYWHEEL_MARK_ANGLE*10);
+	unsigned int elapsed = RPM_TCNT-rpmMarkTicks;
+	if (ticks <= elapsed+1)
+		ticks = elapsed+2; // already passed, run as soon as possible
+	RPM_OCRB = rpmMarkTicks+ticks;
+	RPM_TIFR = (1 << RPM_OCFB); // clear stale match
+	crankTaskArmed = 1;
+	if (!crankTaskHeld)
+		RPM_TIMSK |= (1 << RPM_OCIEB);
+}
 
- static void rpmTimerDisable() {
- 	TCCR1A = 0;
- 	TCCR1B = 0;
- 	rpmDuration = 0;
- }
+ISR(RPM_COMPB_vect)
+{
+	RPM_TIMSK &= ~(1 << RPM_OCIEB);
+	crankTaskArmed = 0;
+	unsigned char i = crankTaskNext;
+	unsigned char mark = crankTaskMark;
+	if (crankTaskBusy) {
+#ifdef TASK_STATS
+		taskStats[crankTasks[i].stats].overruns++;
+#endif
+		return;
+	}
+	crankTaskBusy = 1;
+	sei();
+	TRACE_ENTER(TRACE_CRANK_TASK,i);
+	TASK_STATS_BEGIN(crankTasks[i].stats);
+	crankTasks[i].handler();
+	TASK_STATS_END(crankTasks[i].stats);
+	TRACE_LEAVE(TRACE_CRANK_TASK,i);
+	cli();
+	core.publishControls();
+	crankTaskBusy = 0;
+	// arm next one, unless new mark has restarted the sequence meanwhile
+	if (crankTaskMark == mark && ++crankTaskNext < crankTaskCount)
+		crankTaskArm();
+}
  
 
-ISR(TIMER1_COMPA_vect) 
+ISR(RPM_COMPA_vect) 
 {	
 	// Timer has waited rotation for too long, declare engine as stopped
-	rpmTimerDisable();
+	TRACE_EVENT(TRACE_RPM_STALL,0);
+	rpmStopped = 1;
+	rpmMarkIndex = 0;
+	injectionBegin = 0;
+	RPM_TIMSK &= ~((1 << RPM_OCIEA) | (1 << RPM_OCIEB));
+	crankTaskArmed = 0;
+	angleClockStop();
+	cylinderPhaseReset();
 	core.controls[Core::valueEngineRPM] = 0;
 	core.node[Core::nodeEngineRPM].value = 0;
 	core.controls[Core::valueEngineRPMFiltered] = 0;   
 	rpmDuration = 0;
 	memset(measurements,0,sizeof(measurements));
+	measurementsSum = 0;
+	core.publishControls();
 }
 
 
 
 volatile unsigned char *errCnt;
-volatile long rpmMax;
-volatile long rpmMin;
 
-void rpmTrigger() { 
-	unsigned int dur = TCNT1;
-	unsigned int on=0,off=0;
+// ticks = timer value at the edge
+static inline void rpmMark(unsigned int ticks) __attribute__((always_inline));
+
+static inline void rpmMark(unsigned int ticks) { 
+	unsigned int dur = ticks-rpmMarkTicks;
+	TASK_STATS_BEGIN(TASK_STATS_RPM);
+	TRACE_ENTER(TRACE_RPM,0);
 	if (intHandlerCalls)
 		*errCnt = intHandlerCalls;
 
-	TCNT1 = 0;
-	digitalWrite(PIN_RPM_PROBE,HIGH);
-
-	for (unsigned int i=0;i<10;i++) {
-		if (digitalRead(PIN_INPUT_RPM)) {
-			on++;
-		} else {
-			off++;
-		}
-	}
-	digitalWrite(PIN_RPM_PROBE,LOW);	
-	if (on) {
-		TCNT1 += dur; // restore
+	if (!rpmStopped && dur < (rpmDuration ? RPM_NOISE_WINDOW(rpmDuration) : RPMTIMER_MIN_DURATON)) {
+		// not a valid mark, timestamps are left untouched
 		//*errCnt++;
+		TRACE_LEAVE(TRACE_RPM,1);
+		TASK_STATS_END(TASK_STATS_RPM);
 		return;
 	}
 
@@ -108,7 +180,6 @@ void rpmTrigger() {
 		if (abs((long)rpmAvg-dur)>maxErr) {
 			errCnt++;
 			sei();
-			rpmTimerEnable();
 			return;	
 		} else {
 			rpmAvg += (rpmAvg*3+dur)/4;
@@ -117,13 +188,30 @@ void rpmTrigger() {
 		rpmAvg = dur;
 	}
 	*/
+	rpmMarkTicks = ticks;
+	rpmMarkTime = now_us();
+	// stall detection: a full counter round without next mark
+	RPM_OCRA = ticks-1;
+	RPM_TIFR = (1 << RPM_OCFA);
+	RPM_TIMSK |= (1 << RPM_OCIEA);
+	needleSeen = 0;
+	if (rpmStopped) {
+		// first mark after stop, no duration yet
+		rpmStopped = 0;
+		TRACE_LEAVE(TRACE_RPM,2);
+		TASK_STATS_END(TASK_STATS_RPM);
+		return;
+	}
+
 	rpmDuration = dur; // store duration to be calculated as RPM later
 	if (dur<rpmMin)
 		rpmMin = dur;
 	if (dur>rpmMax)
 		rpmMax = dur;
-		
-	injectionBegin = 0;
+
+	// running sum of one revolution, oldest one drops out of it (ring holds two revolutions)
+	measurementsSum += dur;
+	measurementsSum -= measurements[(currentTick+NUMBER_OF_CYLINDERS)%(NUMBER_OF_CYLINDERS*2)];
 	measurements[currentTick] = dur;
 	currentTick++;
 
@@ -131,6 +219,11 @@ void rpmTrigger() {
 	if (currentTick>(NUMBER_OF_CYLINDERS*2-1))
 		currentTick = 0;
 
+	if (cylinderPhaseValid())
+		angleClockTooth(ticks,rpmMarkIndex*(FLYWHEEL_MARK_ANGLE*10),FLYWHEEL_MARK_ANGLE*10,dur);
+	if (++rpmMarkIndex >= NUMBER_OF_CYLINDERS)
+		rpmMarkIndex = 0;
+
 	if (core.controls[Core::valueRunMode] >= ENGINE_STATE_PID_IDLE &&
 		core.controls[Core::valueRunMode] < ENGINE_STATE_HIGH_LOAD_RANGE) {
 		static int lastMeasure = 0;
@@ -141,9 +234,47 @@ void rpmTrigger() {
 		lastMeasure = measure;
 	}
 
-//	rpmTimerEnable();
- 	TCCR1B = 11; // WGM12 = 8 +CS11 = 2+CS10 = 1
+	if (crankTaskCount) {
+		crankTaskDuration = dur;
+		crankTaskNext = 0;
+		crankTaskMark++;
+		crankTaskArm();
+	}
+	core.publishControls();
+	TRACE_LEAVE(TRACE_RPM,0);
+	TASK_STATS_END(TASK_STATS_RPM);
+}
+
+#ifdef RPM_INPUT_CAPTURE
+ISR(TIMER5_CAPT_vect)
+{
+	rpmMark(ICR5);
+}
+#else
+void rpmTrigger() {
+	rpmMark(RPM_TCNT);
+}
+#endif
 
+// Needle lift sensor of NEEDLELIFTSENSOR_CYLINDER, only first pulse in mark interval is taken
+void needleTrigger() {
+	unsigned int ticks = RPM_TCNT;
+	if (rpmStopped || needleSeen)
+		return;
+	needleSeen = 1;
+	TRACE_EVENT(TRACE_NEEDLE,currentTick);
+	// pulse always follows the mark of needle lift cylinder, timing does not depend on phase
+	unsigned int diff = ticks-rpmMarkTicks;
+	if (injectionBegin)
+		diff = ((unsigned long)(unsigned int)core.controls[Core::valueEngineTimingDiff]+diff)/2;
+	core.controls[Core::valueEngineTimingDiff] = diff;
+	core.publishControls();
+	injectionBegin = 1;
+	// latest mark belongs to needle lift cylinder, next slot to be measured is its first one
+	if (cylinderPhaseNeedle(currentTick) == CYLINDER_PHASE_SYNC) {
+		rpmMarkIndex = 1; // latest mark is angle 0
+		angleClockStop(); // phase moved, angle fed so far is off by marks, next mark restarts it
+	}
 }
 
 // Class methods
@@ -151,48 +282,36 @@ void RPMDefaultCps::init() {
 	errorCount = 0;
 	errCnt = &errorCount;
  	rpmDuration = 0;
-	rpmTimerSetup(); 
-	rpmTimerEnable();		
+	cylinderPhaseInit();
+	rpmTimerSetup(); 		
 }
 
 unsigned int RPMDefaultCps::getLatestMeasure() {
-	if (rpmDuration<10)
+	unsigned int dur = rpmDuration;
+	if (dur<10)
 		return 0;
-	// 64 = timer divider
-	// cli sei is to moved parent class
-//	cli();
-	unsigned int ret=((unsigned long)(60*F_CPU/64/NUMBER_OF_CYLINDERS)/((unsigned long)rpmDuration)); 
-//	sei();
-	return ret;
+	return rpmFromTicks(dur,1);
 }
 
-/*
-	todo: add teeth mapping function for correct cylinder phasing
-*/
 unsigned int RPMDefaultCps::getLatestMeasureFiltered() {
-	// 64 = timer divider
-	unsigned long total = 0;
-	char t = currentTick;
-	
-	for (unsigned char idx=0;idx<NUMBER_OF_CYLINDERS;idx++) {
-		t--;
-		if (t<0) t=NUMBER_OF_CYLINDERS*2-1;
-		total += measurements[(unsigned)t];
-	}
-	total = total/(NUMBER_OF_CYLINDERS);
-	//TODO 
-	if (total==0)
-		return 0;	
+	// average of one revolution, sum is updated on every mark
 	cli();
-	unsigned int ret = ((unsigned long)(60*F_CPU/64/NUMBER_OF_CYLINDERS)/((unsigned long)total)); 
+	unsigned long total = measurementsSum;
 	sei();
-	return ret;
+	return rpmFromTicks(total,NUMBER_OF_CYLINDERS);
 }
 
 unsigned int RPMDefaultCps::getLatestRawValue() {
 	return rpmDuration;
 }
 
+unsigned long RPMDefaultCps::getLastMarkTime() {
+	cli();
+	unsigned long ret = rpmMarkTime;
+	sei();
+	return ret;
+}
+
 int RPMDefaultCps::getInjectionTiming() {
 	if (injectionBegin) {
 			unsigned int timerTicksPerDegree = rpmDuration / (360/NUMBER_OF_CYLINDERS);
@@ -205,10 +324,35 @@ int RPMDefaultCps::getInjectionTiming() {
 	}
 }
 
+// Tasks must be added in order of angle
+bool RPMDefaultCps::addCrankTask(void (*handler)(),unsigned int angle,unsigned char stats) {
+	if (crankTaskCount >= CRANK_TASK_MAX || angle >= FLYWHEEL_MARK_ANGLE*10)
+		return false;
+	cli();
+	crankTasks[crankTaskCount].handler = handler;
+	crankTasks[crankTaskCount].angle = angle;
+	crankTasks[crankTaskCount].stats = stats;
+	crankTaskCount++;
+	sei();
+	return true;
+}
+
+void RPMDefaultCps::holdCrankTasks(bool hold) {
+	crankTaskHeld = hold;
+	if (hold)
+		RPM_TIMSK &= ~(1 << RPM_OCIEB);
+	else if (crankTaskArmed)
+		RPM_TIMSK |= (1 << RPM_OCIEB);
+}
+
 unsigned int RPMDefaultCps::getDeviationForCylinder(unsigned char cyl) {
+	// cylinder is not known without phase
+	signed char slot = cylinderPhaseSlot(cyl);
+	if (slot < 0)
+		return 0;
 	cli();
-	unsigned int v1=measurements[cyl*2];
-	unsigned int v2=measurements[cyl*2+1];
+	unsigned int v1=measurements[slot];
+	unsigned int v2=measurements[(slot+1)%CYLINDER_PHASE_SLOTS];
 	sei();
 	static long cyl0Timing;
 	
@@ -217,8 +361,6 @@ unsigned int RPMDefaultCps::getDeviationForCylinder(unsigned char cyl) {
 		cyl0Timing = (v1 + v2)/2;
 		return cyl0Timing;
 	}
-	if (cyl >= NUMBER_OF_CYLINDERS)
-		return 0;
 	long deviation = cyl0Timing-(v1+v2)/2;
 	if (deviation<-32000)
 		return -32000;
@@ -227,3 +369,5 @@ unsigned int RPMDefaultCps::getDeviationForCylinder(unsigned char cyl) {
 		
 	return deviation;
 }
+
+#endif
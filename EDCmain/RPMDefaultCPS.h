@@ -13,6 +13,7 @@
 // ((((16000000/64)/65535)*60/5                         16000000L             4000 ~ 780rpm
 #define RPMTIMER_DURATION_TO_RPM(x) ((unsigned long)(60*F_CPU/64/NUMBER_OF_CYLINDERS)/((unsigned long)x))  // 250 000hz frequency (max. 65535 ticks per teeth ~45rpm)
 #define RPMTIMER_MIN_DURATON 400 // 7500rpm
+#define RPM_NOISE_WINDOW(x) ((x)>>1) // edges earlier than half of previous mark to mark duration are noise
 
 
 class RPMDefaultCps : public RPMBase {
@@ -23,6 +24,9 @@ class RPMDefaultCps : public RPMBase {
 	unsigned int getLatestRawValue();
 	int getInjectionTiming();
 	unsigned int getDeviationForCylinder(unsigned char cyl);
+	unsigned long getLastMarkTime();
+	bool addCrankTask(void (*handler)(),unsigned int angle,unsigned char stats);
+	void holdCrankTasks(bool hold);
 	private:
 	void setupTimers();
 
@@ -0,0 +1,64 @@
+#ifndef RPMTIMER_H
+#define RPMTIMER_H
+
+#include "defines.h"
+#include "Arduino.h"
+
+/*
+ * Registers of the free running timer used for crank timestamps (RPMDefaultCps, RPMToothWheel).
+ * Timer 1 with INT0 (pin 2) input, or Timer 5 with ICP5 (pin 48) input when RPM_INPUT_CAPTURE is set.
+ * Compare A: stall detection, compare B: crank tasks (RPMDefaultCps), compare C: angle clock callback.
+ */
+
+#ifdef RPM_INPUT_CAPTURE
+#define RPM_TCCRA TCCR5A
+#define RPM_TCCRB TCCR5B
+#define RPM_TCNT TCNT5
+#define RPM_OCRA OCR5A
+#define RPM_OCRB OCR5B
+#define RPM_OCRC OCR5C
+#define RPM_TIFR TIFR5
+#define RPM_TIMSK TIMSK5
+#define RPM_COMPA_vect TIMER5_COMPA_vect
+#define RPM_COMPB_vect TIMER5_COMPB_vect
+#define RPM_COMPC_vect TIMER5_COMPC_vect
+#else
+#define RPM_TCCRA TCCR1A
+#define RPM_TCCRB TCCR1B
+#define RPM_TCNT TCNT1
+#define RPM_OCRA OCR1A
+#define RPM_OCRB OCR1B
+#define RPM_OCRC OCR1C
+#define RPM_TIFR TIFR1
+#define RPM_TIMSK TIMSK1
+#define RPM_COMPA_vect TIMER1_COMPA_vect
+#define RPM_COMPB_vect TIMER1_COMPB_vect
+#define RPM_COMPC_vect TIMER1_COMPC_vect
+#endif
+// interrupt enable & flag bits are at same positions on all 16-bit timers
+#define RPM_OCFA OCF1A
+#define RPM_OCFB OCF1B
+#define RPM_OCFC OCF1C
+#define RPM_OCIEA OCIE1A
+#define RPM_OCIEB OCIE1B
+#define RPM_OCIEC OCIE1C
+
+// Enables edge input: input capture interrupt, or INT0 calling rpmTrigger(), and needle lift sensor
+// input calling needleTrigger(). Call with interrupts disabled.
+void rpmTrigger();
+void needleTrigger();
+
+static inline void rpmInputEnable() {
+#ifdef RPM_INPUT_CAPTURE
+	// ICP5 -- PIN48 -- Cherry GS sensor, falling edge (ICES5 = 0), noise canceler on
+	RPM_TCCRB |= (1 << ICNC5);
+	TIFR5 = (1 << ICF5);
+	TIMSK5 |= (1 << ICIE5);
+#else
+	//attachInterrupt(0, rpmTrigger, RISING);  // Interrupt 0 -- PIN2 -- LM1815 gated output
+	attachInterrupt(0, rpmTrigger, FALLING);  // Interrupt 0 -- PIN2 -- Cherry GS sensor
+#endif
+	attachInterrupt(1, needleTrigger, FALLING);  // Interrupt 1 -- PIN3 -- needle lift sensor, from voltage comparator, default +5v
+}
+
+#endif
@@ -0,0 +1,420 @@
+#ifndef RPMTOOTHWHEEL_H
+#define RPMTOOTHWHEEL_H
+
+#include "RPMBase.h"
+#include "RPMTimer.h"
+#include "Arduino.h"
+#include "Core.h"
+#include "BackgroundADC.h"
+#include "TaskStats.h"
+#include "TimeBase.h"
+#include "Trace.h"
+#include "AngleClock.h"
+#include "CylinderPhase.h"
+
+/*
+ * RPM calculation - toothed wheel, with or without missing teeth gap (60-2, 36-1, 144-0 ...)
+ *
+ * TEETH is number of tooth positions on the wheel (missing ones included), MISSING number of missing
+ * teeth. Tooth after the gap is index 0. Gap is detected when tooth period is more than (MISSING+0.5)
+ * times the previous tooth period. Gap seen at wrong tooth restarts counting from it, gap not seen where
+ * expected loses sync until next gap, both increment errorCount. Without gap (MISSING = 0)
+ * index is relative to the first tooth seen after stop.
+ *
+ * Revolution is divided to CYLINDERS segments (boundaries are spread evenly, segments differ by one
+ * tooth at most, gap ticks are accounted to segment where the gap starts), segments are counted over
+ * the engine cycle (2*CYLINDERS). Latest RPM is calculated from the latest segment, filtered RPM from
+ * the latest full revolution. Deviation needs cylinder phase (CylinderPhase.h): first needle lift
+ * pulse in a segment tells the segment, and CYLINDERS must equal NUMBER_OF_CYLINDERS. Values are
+ * returned in 250kHz ticks like RPMDefaultCps. Angle clock (AngleClock.h) is fed on every tooth while
+ * synced, tooth index 0 is angle 0. Without gap tooth 0 is not a fixed position, the clock is not fed.
+ *
+ * Segment boundaries take the role of flywheel marks: the first boundary (tooth 0) is at BTDC_MARK, QA
+ * position is sampled on each boundary (idle and low load, like RPMDefaultCps) and injection timing is
+ * the time from segment start to the first needle lift pulse in the segment. A boundary tooth that is
+ * off the even division is corrected by its angle offset.
+ *
+ * Timer runs at 2MHz with 60 or more tooth positions, otherwise at 250kHz. Engine is declared stopped
+ * after a full counter round without a tooth (32ms at 2MHz, 60-2 gap at ~95rpm).
+ *
+ * Edge ISR has no loops. Without a pending angle clock callback it has no divisions either, worst path
+ * (segment and revolution end on the same tooth, QA sample, segment min/max) is estimated to 300 cycles
+ * + interrupt entry (~80 cycles with attachInterrupt dispatch, less with RPM_INPUT_CAPTURE). At 144
+ * teeth * 5000rpm edges are 83us (1333 cycles) apart, so decoding takes about 30% of CPU at that speed.
+ * A pending callback (angleClockSchedule) adds a 32-bit division (~600 cycles) on the tooth whose
+ * interval contains the target angle. Getters are O(1) as well.
+ *
+ * rpmMin/rpmMax record segment periods normalized to 1/NUMBER_OF_CYLINDERS revolution in 250kHz ticks,
+ * same as mark periods of RPMDefaultCps.
+ *
+ * Usage: one instance per program, ISRs are defined with RPM_TOOTH_WHEEL_ISR(type) at file level.
+ */
+
+#define RPM_TOOTH_WHEEL_MAX_RPM 7500 // teeth faster than this are noise
+#define RPM_TOOTH_NOISE_WINDOW(x) ((x)>>2) // edges earlier than quarter of previous tooth period are noise
+
+template <unsigned char TEETH,unsigned char MISSING,unsigned char CYLINDERS>
+class RPMToothWheel : public RPMBase {
+	static_assert(CYLINDERS && TEETH/CYLINDERS > MISSING,"gap must fit in one cylinder segment");
+	static_assert(TEETH/CYLINDERS <= 48,"segment tick sum would overflow");
+	static_assert(ANGLE_CLOCK_REVOLUTION % TEETH == 0,"tooth angle must be whole 0.1 degrees");
+	static_assert(TEETH-1+(MISSING+1)*CYLINDERS <= 255,"segment accumulator would overflow");
+
+	public:
+	void init();
+	unsigned int getLatestMeasure();
+	unsigned int getLatestMeasureFiltered();
+	unsigned int getLatestRawValue();
+	int getInjectionTiming();
+	unsigned int getDeviationForCylinder(unsigned char cyl);
+	unsigned long getLastMarkTime();
+	unsigned char getToothIndex();
+	bool isSynced();
+
+	static void edge(unsigned int ticks);
+	static void stall();
+	static void needle();
+
+	private:
+	enum {
+		tickShift = TEETH >= 60 ? 3 : 0, // timer ticks to 250kHz ticks
+		minPeriod = ((unsigned long)RPMTIMER_TICKS_PER_MINUTE<<tickShift)/((unsigned long)RPM_TOOTH_WHEEL_MAX_RPM*TEETH),
+		segmentTeethMax = (TEETH+CYLINDERS-1)/CYLINDERS+MISSING,
+		toothAngle = ANGLE_CLOCK_REVOLUTION/TEETH // 0.1°
+	};
+
+	static struct stateStruct {
+		unsigned int lastTicks; // timer timestamp of latest accepted tooth
+		unsigned int toothPeriod; // latest tooth period, gaps excluded
+		unsigned char toothIndex;
+		unsigned char synced;
+		unsigned char stopped;
+		unsigned char segment;
+		unsigned char segmentAcc; // segment boundary accumulator, += CYLINDERS per tooth position
+		unsigned char segmentTeeth;
+		unsigned char latestSegment;
+		unsigned char needleSeen; // needle lift pulse in current segment
+		unsigned char segmentStartTooth; // tooth index of current segment start
+		unsigned char injectionBegin; // valueEngineTimingDiff is valid
+		int needleOffset; // 0.1°, segment start of latest needle pulse from even division
+		unsigned long segmentSum;
+		unsigned long revolutionSum;
+		unsigned long revolutionTicks; // latest full revolution
+		unsigned long segmentTicks[CYLINDERS*2]; // latest per segment sums, engine cycle
+		unsigned char segmentToothCount[CYLINDERS*2]; // tooth positions in segmentTicks
+		unsigned long markTime; // now_us()
+		volatile unsigned char *errors;
+	} volatile st;
+	// segment sum * scale >> 10 = ticks of 1/CYLINDERS revolution, index is tooth positions in segment
+	static unsigned int segmentScale[segmentTeethMax+1];
+
+	static void resetSegments();
+	static void angleClockFeed(unsigned int ticks);
+	static unsigned long segmentNormalized(unsigned char cyl);
+};
+
+template <unsigned char TEETH,unsigned char MISSING,unsigned char CYLINDERS>
+volatile typename RPMToothWheel<TEETH,MISSING,CYLINDERS>::stateStruct RPMToothWheel<TEETH,MISSING,CYLINDERS>::st;
+
+template <unsigned char TEETH,unsigned char MISSING,unsigned char CYLINDERS>
+unsigned int RPMToothWheel<TEETH,MISSING,CYLINDERS>::segmentScale[segmentTeethMax+1];
+
+// Call with interrupts disabled
+template <unsigned char TEETH,unsigned char MISSING,unsigned char CYLINDERS>
+void RPMToothWheel<TEETH,MISSING,CYLINDERS>::resetSegments() {
+	st.toothIndex = 0;
+	st.segment = 0;
+	st.segmentAcc = 0;
+	st.segmentTeeth = 0;
+	st.segmentSum = 0;
+	st.segmentStartTooth = 0;
+	st.revolutionSum = 0;
+	// segment numbering restarts
+	cylinderPhaseReset();
+}
+
+// Angle and predicted period to next tooth (over the gap if it is next). Call with interrupts disabled
+template <unsigned char TEETH,unsigned char MISSING,unsigned char CYLINDERS>
+void RPMToothWheel<TEETH,MISSING,CYLINDERS>::angleClockFeed(unsigned int ticks) {
+	if (!MISSING)
+		return;
+	if (st.toothIndex == TEETH-MISSING-1)
+		angleClockTooth(ticks,st.toothIndex*toothAngle,toothAngle*(MISSING+1),(unsigned long)st.toothPeriod*(MISSING+1));
+	else
+		angleClockTooth(ticks,st.toothIndex*toothAngle,toothAngle,st.toothPeriod);
+}
+
+template <unsigned char TEETH,unsigned char MISSING,unsigned char CYLINDERS>
+void RPMToothWheel<TEETH,MISSING,CYLINDERS>::edge(unsigned int ticks) {
+	unsigned int dur = ticks-st.lastTicks;
+	unsigned char teeth = 1;
+	TASK_STATS_BEGIN(TASK_STATS_RPM);
+	TRACE_ENTER(TRACE_RPM,0);
+
+	if (!st.stopped && dur < (st.toothPeriod ? RPM_TOOTH_NOISE_WINDOW(st.toothPeriod) : minPeriod)) {
+		// not a valid tooth, timestamps are left untouched
+		TRACE_LEAVE(TRACE_RPM,1);
+		TASK_STATS_END(TASK_STATS_RPM);
+		return;
+	}
+	st.lastTicks = ticks;
+	st.markTime = now_us();
+	// stall detection: a full counter round without next tooth
+	RPM_OCRA = ticks-1;
+	RPM_TIFR = (1 << RPM_OCFA);
+	RPM_TIMSK |= (1 << RPM_OCIEA);
+	if (st.stopped) {
+		// first tooth after stop, no period yet
+		st.stopped = 0;
+		st.synced = 0;
+		st.toothPeriod = 0;
+		TRACE_LEAVE(TRACE_RPM,2);
+		TASK_STATS_END(TASK_STATS_RPM);
+		return;
+	}
+
+	bool gap = MISSING && st.toothPeriod && dur > (unsigned long)st.toothPeriod*MISSING+(st.toothPeriod>>1);
+	if (gap) {
+		teeth = MISSING+1;
+	} else {
+		st.toothPeriod = dur;
+	}
+
+	if (!st.synced) {
+		// without gap any tooth will do as reference
+		if (gap || !MISSING) {
+			resetSegments();
+			st.synced = 1;
+			angleClockFeed(ticks);
+		}
+		TRACE_LEAVE(TRACE_RPM,0);
+		TASK_STATS_END(TASK_STATS_RPM);
+		return;
+	}
+	if (MISSING && gap != (st.toothIndex == TEETH-MISSING-1)) {
+		// gap at wrong place (counting restarts from it) or missing
+		(*st.errors)++;
+		if (gap) {
+			resetSegments();
+			angleClockFeed(ticks);
+		} else {
+			st.synced = 0;
+			angleClockStop();
+		}
+		TRACE_LEAVE(TRACE_RPM,3);
+		TASK_STATS_END(TASK_STATS_RPM);
+		return;
+	}
+
+	st.segmentSum += dur;
+	st.revolutionSum += dur;
+	st.segmentTeeth += teeth;
+	st.segmentAcc += teeth*CYLINDERS;
+	if (st.segmentAcc >= TEETH) {
+		st.segmentAcc -= TEETH;
+		st.segmentTicks[st.segment] = st.segmentSum;
+		st.segmentToothCount[st.segment] = st.segmentTeeth;
+		st.latestSegment = st.segment;
+		unsigned long period = segmentNormalized(st.segment);
+		if (CYLINDERS != NUMBER_OF_CYLINDERS)
+			period = period*CYLINDERS/NUMBER_OF_CYLINDERS;
+		if ((long)period<rpmMin)
+			rpmMin = period;
+		if ((long)period>rpmMax)
+			rpmMax = period;
+		st.segmentSum = 0;
+		st.segmentTeeth = 0;
+		st.needleSeen = 0;
+		if (++st.segment >= CYLINDERS*2)
+			st.segment = 0;
+		if (core.controls[Core::valueRunMode] >= ENGINE_STATE_PID_IDLE &&
+			core.controls[Core::valueRunMode] < ENGINE_STATE_HIGH_LOAD_RANGE) {
+			static int lastMeasure = 0;
+			int measure = adc.readValue_interrupt_safe(PIN_ANALOG_QA_POS);
+			if (!lastMeasure)
+				lastMeasure=measure;
+			core.controls[Core::valueQAfeedbackActual] = (lastMeasure+measure)/2;
+			lastMeasure = measure;
+		}
+	}
+	st.toothIndex += teeth;
+	if (st.toothIndex >= TEETH) {
+		st.toothIndex -= TEETH;
+		st.revolutionTicks = st.revolutionSum;
+		st.revolutionSum = 0;
+	}
+	if (!st.segmentTeeth)
+		st.segmentStartTooth = st.toothIndex;
+	angleClockFeed(ticks);
+	core.publishControls();
+	TRACE_LEAVE(TRACE_RPM,0);
+	TASK_STATS_END(TASK_STATS_RPM);
+}
+
+template <unsigned char TEETH,unsigned char MISSING,unsigned char CYLINDERS>
+void RPMToothWheel<TEETH,MISSING,CYLINDERS>::stall() {
+	// Timer has waited rotation for too long, declare engine as stopped
+	TRACE_EVENT(TRACE_RPM_STALL,0);
+	st.stopped = 1;
+	st.synced = 0;
+	st.injectionBegin = 0;
+	RPM_TIMSK &= ~(1 << RPM_OCIEA);
+	angleClockStop();
+	st.toothPeriod = 0;
+	st.revolutionTicks = 0;
+	for (unsigned char i=0;i<CYLINDERS*2;i++) {
+		st.segmentTicks[i] = 0;
+		st.segmentToothCount[i] = 0;
+	}
+	resetSegments();
+	core.controls[Core::valueEngineRPM] = 0;
+	core.node[Core::nodeEngineRPM].value = 0;
+	core.controls[Core::valueEngineRPMFiltered] = 0;
+	core.publishControls();
+}
+
+// Needle lift sensor, only first pulse in segment is taken
+template <unsigned char TEETH,unsigned char MISSING,unsigned char CYLINDERS>
+void RPMToothWheel<TEETH,MISSING,CYLINDERS>::needle() {
+	unsigned int ticks = RPM_TCNT;
+	if (!st.synced || st.needleSeen)
+		return;
+	st.needleSeen = 1;
+	TRACE_EVENT(TRACE_NEEDLE,st.segment);
+	// slots are cylinder segments only when FIRING_ORDER describes this wheel
+	if (CYLINDERS == NUMBER_OF_CYLINDERS)
+		cylinderPhaseNeedle(st.segment);
+	// teeth of the segment so far plus time since latest tooth, 16-bit timer alone would wrap at 2MHz
+	unsigned long since = (st.segmentSum+(unsigned int)(ticks-st.lastTicks))>>tickShift;
+	unsigned int diff = since > 0xffff ? 0xffff : since;
+	if (st.injectionBegin)
+		diff = ((unsigned long)(unsigned int)core.controls[Core::valueEngineTimingDiff]+diff)/2;
+	core.controls[Core::valueEngineTimingDiff] = diff;
+	core.publishControls();
+	// needle cylinder always lands in the same segment of revolution, offset stays constant
+	st.needleOffset = st.segmentStartTooth*toothAngle-
+		(int)((unsigned long)(st.segment%CYLINDERS)*ANGLE_CLOCK_REVOLUTION/CYLINDERS);
+	st.injectionBegin = 1;
+}
+
+template <unsigned char TEETH,unsigned char MISSING,unsigned char CYLINDERS>
+void RPMToothWheel<TEETH,MISSING,CYLINDERS>::init() {
+	errorCount = 0;
+	st.errors = &errorCount;
+	st.stopped = 1;
+	cylinderPhaseInit();
+	for (unsigned char n=1;n<=segmentTeethMax;n++)
+		segmentScale[n] = ((unsigned long)TEETH*1024+n*CYLINDERS/2)/(n*CYLINDERS);
+	cli();
+	RPM_TCCRA = 0;
+	RPM_TCCRB = tickShift ? 2 : 3; // normal mode (free running), 2MHz or 250kHz
+	RPM_OCRA = RPM_TCNT-1;
+	RPM_TIFR = (1 << RPM_OCFA);
+	RPM_TIMSK |= (1 << RPM_OCIEA);
+	rpmInputEnable();
+	sei();
+}
+
+// Ticks (250kHz) of 1/CYLINDERS revolution, from latest sum of segment. Call with interrupts disabled
+template <unsigned char TEETH,unsigned char MISSING,unsigned char CYLINDERS>
+unsigned long RPMToothWheel<TEETH,MISSING,CYLINDERS>::segmentNormalized(unsigned char cyl) {
+	return (st.segmentTicks[cyl]*segmentScale[st.segmentToothCount[cyl]]>>10)>>tickShift;
+}
+
+template <unsigned char TEETH,unsigned char MISSING,unsigned char CYLINDERS>
+unsigned int RPMToothWheel<TEETH,MISSING,CYLINDERS>::getLatestMeasure() {
+	cli();
+	unsigned long ticks = segmentNormalized(st.latestSegment);
+	sei();
+	return rpmFromTicks(ticks*CYLINDERS,NUMBER_OF_CYLINDERS);
+}
+
+template <unsigned char TEETH,unsigned char MISSING,unsigned char CYLINDERS>
+unsigned int RPMToothWheel<TEETH,MISSING,CYLINDERS>::getLatestMeasureFiltered() {
+	cli();
+	unsigned long ticks = st.revolutionTicks;
+	sei();
+	return rpmFromTicks(ticks>>tickShift,NUMBER_OF_CYLINDERS);
+}
+
+template <unsigned char TEETH,unsigned char MISSING,unsigned char CYLINDERS>
+unsigned int RPMToothWheel<TEETH,MISSING,CYLINDERS>::getLatestRawValue() {
+	cli();
+	unsigned long ticks = segmentNormalized(st.latestSegment);
+	sei();
+	return ticks > 0xffff ? 0xffff : ticks;
+}
+
+template <unsigned char TEETH,unsigned char MISSING,unsigned char CYLINDERS>
+int RPMToothWheel<TEETH,MISSING,CYLINDERS>::getInjectionTiming() {
+	cli();
+	if (!st.injectionBegin) {
+		sei();
+		return 0;
+	}
+	unsigned long ticks = segmentNormalized(st.latestSegment);
+	int offset = st.needleOffset;
+	sei();
+	unsigned int timerTicksPerDegree = ticks/(360/CYLINDERS);
+	if (!timerTicksPerDegree)
+		return 0;
+	// *10 fixed point like RPMDefaultCps, boundary is at BTDC_MARK
+	unsigned int advanceRelative = ((unsigned long)(unsigned int)core.controls[Core::valueEngineTimingDiff]*10)/timerTicksPerDegree;
+	return BTDC_MARK-offset-advanceRelative;
+}
+
+template <unsigned char TEETH,unsigned char MISSING,unsigned char CYLINDERS>
+unsigned int RPMToothWheel<TEETH,MISSING,CYLINDERS>::getDeviationForCylinder(unsigned char cyl) {
+	static long cyl0Timing;
+	if (CYLINDERS != NUMBER_OF_CYLINDERS)
+		return 0;
+	// cylinder is not known without phase
+	signed char slot = cylinderPhaseSlot(cyl);
+	if (slot < 0)
+		return 0;
+	cli();
+	long v = (segmentNormalized(slot)+segmentNormalized((slot+1)%(CYLINDERS*2)))/2;
+	sei();
+	if (cyl == 0) {
+		cyl0Timing = v;
+		return cyl0Timing;
+	}
+	long deviation = cyl0Timing-v;
+	if (deviation<-32000)
+		return -32000;
+	if (deviation>32000)
+		return 32000;
+	return deviation;
+}
+
+template <unsigned char TEETH,unsigned char MISSING,unsigned char CYLINDERS>
+unsigned long RPMToothWheel<TEETH,MISSING,CYLINDERS>::getLastMarkTime() {
+	cli();
+	unsigned long ret = st.markTime;
+	sei();
+	return ret;
+}
+
+template <unsigned char TEETH,unsigned char MISSING,unsigned char CYLINDERS>
+unsigned char RPMToothWheel<TEETH,MISSING,CYLINDERS>::getToothIndex() {
+	return st.toothIndex;
+}
+
+template <unsigned char TEETH,unsigned char MISSING,unsigned char CYLINDERS>
+bool RPMToothWheel<TEETH,MISSING,CYLINDERS>::isSynced() {
+	return st.synced;
+}
+
+#ifdef RPM_INPUT_CAPTURE
+#define RPM_TOOTH_WHEEL_ISR(type) \
+	ISR(RPM_COMPA_vect) { type::stall(); } \
+	ISR(TIMER5_CAPT_vect) { type::edge(ICR5); } \
+	void needleTrigger() { type::needle(); }
+#else
+#define RPM_TOOTH_WHEEL_ISR(type) \
+	ISR(RPM_COMPA_vect) { type::stall(); } \
+	void rpmTrigger() { type::edge(RPM_TCNT); } \
+	void needleTrigger() { type::needle(); }
+#endif
+
+#endif
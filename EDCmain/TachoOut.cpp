@@ -14,17 +14,34 @@ static unsigned int period=4800;
 // 4500 = 6500rpm
 
 
+// Phase & frequency correct PWM, timer5 (pin 45) or timer1 (pin 12) when timer5 is used for rpm counting
+#ifdef RPM_INPUT_CAPTURE
+#define TACHO_TCCRA TCCR1A
+#define TACHO_TCCRB TCCR1B
+#define TACHO_ICR ICR1
+#define TACHO_OCR OCR1B
+#else
+#define TACHO_TCCRA TCCR5A
+#define TACHO_TCCRB TCCR5B
+#define TACHO_ICR ICR5
+#define TACHO_OCR OCR5B
+#endif
+
 void TachoOut::init() {
-	TCCR5A = 0;                
-  	TCCR5B = _BV(WGM13);     
+	TACHO_TCCRA = 0;                
+  	TACHO_TCCRB = _BV(WGM13);     
   	//char clockSelectBits = _BV(CS51); //8
 	char clockSelectBits = _BV(CS50);   	
- 	ICR5 = period;                                                   // ICR1 is TOP in p & f correct pwm mode
- 	OCR5A = period/2;
-  	TCCR5B &= ~(_BV(CS50) | _BV(CS51) | _BV(CS52));
-  	TCCR5B |= clockSelectBits;  
+ 	TACHO_ICR = period;                                                   // ICR1 is TOP in p & f correct pwm mode
+ 	TACHO_OCR = period/2;
+  	TACHO_TCCRB &= ~(_BV(CS50) | _BV(CS51) | _BV(CS52));
+  	TACHO_TCCRB |= clockSelectBits;  
   	// DDRL |= _BV(PORTL3); TCCR5A |= _BV(COM5A1);   
-  	DDRL |= _BV(PORTL4); TCCR5A |= _BV(COM5B1);  	// pin45
+#ifdef RPM_INPUT_CAPTURE
+	DDRB |= _BV(PORTB6); TACHO_TCCRA |= _BV(COM1B1);  	// pin12
+#else
+  	DDRL |= _BV(PORTL4); TACHO_TCCRA |= _BV(COM5B1);  	// pin45
+#endif
 }
 
 void TachoOut::setRpm (unsigned int rpm) {
@@ -33,7 +50,7 @@ void TachoOut::setRpm (unsigned int rpm) {
 	long int base=(65535*445)/rpm;
 	if (base>0xffff)
 		base=0xffff;
-	ICR5 = base;                                                   // ICR1 is TOP in p & f correct pwm mode
+	TACHO_ICR = base;                                                   // ICR1 is TOP in p & f correct pwm mode
  	//OCR5A = base/2;
- 	OCR5B = base/2;
+ 	TACHO_OCR = base/2;
 }
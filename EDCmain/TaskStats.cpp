@@ -0,0 +1,82 @@
+#include "TaskStats.h"
+
+volatile taskStatsStruct taskStats[TASK_STATS_MAX];
+
+const char taskStatsName0[] PROGMEM = "Timer3 handler";
+const char taskStatsName1[] PROGMEM = "QA servo";
+const char taskStatsName2[] PROGMEM = "Fast sensors";
+const char taskStatsName3[] PROGMEM = "RPM trigger";
+const char taskStatsName4[] PROGMEM = "Engine control";
+const char taskStatsName5[] PROGMEM = "Idle PID";
+const char taskStatsName6[] PROGMEM = "Relays";
+const char taskStatsName7[] PROGMEM = "Half second";
+const char taskStatsName8[] PROGMEM = "Second";
+const char taskStatsName9[] PROGMEM = "edcConf stream";
+const char taskStatsName10[] PROGMEM = "User interface";
+const char taskStatsName11[] PROGMEM = "Fuel (crank)";
+
+const char * const taskStatsNames[TASK_STATS_MAX] PROGMEM = {
+	taskStatsName0,taskStatsName1,taskStatsName2,taskStatsName3,taskStatsName4,taskStatsName5,
+	taskStatsName6,taskStatsName7,taskStatsName8,taskStatsName9,taskStatsName10,taskStatsName11};
+
+void taskStatsInit(unsigned char id,unsigned long period) {
+	taskStats[id].period = period;
+}
+
+void taskStatsReset() {
+	for (unsigned char i=0;i<TASK_STATS_MAX;i++) {
+		volatile taskStatsStruct *s = &taskStats[i];
+		unsigned char oldSREG = SREG;
+		cli();
+		s->lastStart = 0;
+		s->sumTime = 0;
+		s->calls = 0;
+		s->minTime = 0xffff;
+		s->maxTime = 0;
+		s->maxJitter = 0;
+		s->overruns = 0;
+		SREG = oldSREG;
+	}
+}
+
+unsigned long taskStatsBegin(unsigned char id) {
+	unsigned long now = now_us();
+	volatile taskStatsStruct *s = &taskStats[id];
+	if (s->period && s->lastStart) {
+		long jitter = (long)(now-s->lastStart-s->period);
+		if (jitter<0)
+			jitter = -jitter;
+		if (jitter>0xffff)
+			jitter = 0xffff;
+		if ((unsigned int)jitter>s->maxJitter)
+			s->maxJitter = jitter;
+	}
+	s->lastStart = now;
+	return now;
+}
+
+void taskStatsEnd(unsigned char id,unsigned long start) {
+	unsigned long t = now_us()-start;
+	volatile taskStatsStruct *s = &taskStats[id];
+	if (t>0xffff)
+		t = 0xffff;
+	if (s->calls == 0xffff) {
+		s->calls /= 2;
+		s->sumTime /= 2;
+	}
+	s->calls++;
+	s->sumTime += t;
+	if (t<s->minTime)
+		s->minTime = t;
+	if (t>s->maxTime)
+		s->maxTime = t;
+	if (s->period && t>s->period)
+		s->overruns++;
+}
+
+void taskStatsCopy(unsigned char id,taskStatsStruct *dest) {
+	unsigned char oldSREG = SREG;
+	cli();
+	memcpy(dest,(const void*)&taskStats[id],sizeof(taskStatsStruct));
+	SREG = oldSREG;
+}
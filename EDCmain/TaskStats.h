@@ -0,0 +1,60 @@
+#ifndef TASKSTATS_H
+#define TASKSTATS_H
+
+#include "defines.h"
+#include "Arduino.h"
+#include "TimeBase.h"
+
+/*
+	Execution time, start jitter and overrun statistics of ISR handlers and main loop tasks.
+	Time base is now_us() (TimeBase.h), 4us resolution. The ADC ISR (~9kHz, a few us) is not
+	instrumented, it would be below resolution and the two timestamps would cost more than the ISR.
+
+	Jitter is the largest deviation of interval between two starts from the nominal period,
+	overrun is counted when execution takes longer than the period. Tasks without period (event
+	driven ISRs) record execution times only.
+*/
+
+#define TASK_STATS_TIMER3 0 /* whole mainInterruptHandler */
+#define TASK_STATS_QA 1
+#define TASK_STATS_FAST_SENSORS 2
+#define TASK_STATS_RPM 3
+#define TASK_STATS_LOOP_ENGINE 4
+#define TASK_STATS_LOOP_IDLE 5
+#define TASK_STATS_LOOP_RELAY 6
+#define TASK_STATS_LOOP_HALF_SECOND 7
+#define TASK_STATS_LOOP_SECOND 8
+#define TASK_STATS_LOOP_EDCCONF 9
+#define TASK_STATS_LOOP_UI 10
+#define TASK_STATS_CRANK_FUEL 11
+#define TASK_STATS_MAX 12
+
+struct taskStatsStruct {
+	unsigned long period; // nominal period, us (0 = event driven)
+	unsigned long lastStart;
+	unsigned long sumTime; // for mean
+	unsigned int calls; // since reset (halved with sumTime when about to overflow)
+	unsigned int minTime; // us
+	unsigned int maxTime;
+	unsigned int maxJitter;
+	unsigned int overruns;
+};
+
+extern volatile taskStatsStruct taskStats[TASK_STATS_MAX];
+extern const char * const taskStatsNames[TASK_STATS_MAX] PROGMEM;
+
+void taskStatsInit(unsigned char id,unsigned long period);
+void taskStatsReset();
+unsigned long taskStatsBegin(unsigned char id);
+void taskStatsEnd(unsigned char id,unsigned long start);
+void taskStatsCopy(unsigned char id,taskStatsStruct *dest); // interrupt safe copy
+
+#ifdef TASK_STATS
+#define TASK_STATS_BEGIN(id) unsigned long taskStatsStart = taskStatsBegin(id)
+#define TASK_STATS_END(id) taskStatsEnd(id,taskStatsStart)
+#else
+#define TASK_STATS_BEGIN(id)
+#define TASK_STATS_END(id)
+#endif
+
+#endif
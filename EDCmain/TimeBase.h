@@ -0,0 +1,30 @@
+#ifndef TIMEBASE_H
+#define TIMEBASE_H
+
+#include "Arduino.h"
+
+/*
+	System wide monotonic time base, 32-bit microseconds (wraps around after ~71 minutes, compare
+	timestamps by subtraction). Callable from interrupt handlers and main loop.
+
+	Free running Timer0 (prescaler 64, 4us per count) extended to 32 bits with the overflow counter
+	maintained by Arduino core.
+*/
+
+extern volatile unsigned long timer0_overflow_count; // wiring.c
+
+static inline unsigned long now_us() __attribute__((always_inline));
+
+static inline unsigned long now_us() {
+	unsigned char oldSREG = SREG;
+	cli();
+	unsigned long overflows = timer0_overflow_count;
+	unsigned char count = TCNT0;
+	// overflow pending but not yet counted by ISR
+	if ((TIFR0 & _BV(TOV0)) && count < 255)
+		overflows++;
+	SREG = oldSREG;
+	return ((overflows << 8) | count) << 2;
+}
+
+#endif
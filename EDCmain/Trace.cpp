@@ -0,0 +1,56 @@
+#include "Trace.h"
+
+#ifdef TRACE
+#include "TimeBase.h"
+
+static volatile traceRecordStruct traceBuffer[TRACE_BUFFER_SIZE];
+static volatile unsigned char traceHead; // next record to write
+static volatile unsigned char traceCount;
+static volatile bool traceFrozen; // set while dumping
+
+void traceWrite(unsigned char id,unsigned char payload) {
+	unsigned char oldSREG = SREG;
+	cli();
+	if (!traceFrozen) {
+		volatile traceRecordStruct *r = &traceBuffer[traceHead];
+		r->id = id;
+		r->payload = payload;
+		r->time = now_us();
+		traceHead = (traceHead+1) & (TRACE_BUFFER_SIZE-1);
+		if (traceCount < TRACE_BUFFER_SIZE)
+			traceCount++;
+	}
+	SREG = oldSREG;
+}
+
+// Passes records oldest first to send() in blocks of whole records, tracing is paused meanwhile
+// and ring is empty afterwards.
+void traceDump(void (*send)(const unsigned char *data,unsigned char len)) {
+	const unsigned char perBlock = 240/TRACE_RECORD_SIZE;
+	unsigned char block[perBlock*TRACE_RECORD_SIZE];
+
+	traceFrozen = true;
+	unsigned char idx = (traceHead-traceCount) & (TRACE_BUFFER_SIZE-1);
+	unsigned char left = traceCount;
+	while (left) {
+		unsigned char n = left < perBlock ? left : perBlock;
+		unsigned char *p = block;
+		for (unsigned char i=0;i<n;i++) {
+			volatile traceRecordStruct *r = &traceBuffer[idx];
+			unsigned long time = r->time;
+			*p++ = r->id;
+			*p++ = r->payload;
+			*p++ = time;
+			*p++ = time >> 8;
+			*p++ = time >> 16;
+			*p++ = time >> 24;
+			idx = (idx+1) & (TRACE_BUFFER_SIZE-1);
+		}
+		send(block,n*TRACE_RECORD_SIZE);
+		left -= n;
+	}
+	send(block,0); // end of dump
+	traceCount = 0;
+	traceFrozen = false;
+}
+#endif
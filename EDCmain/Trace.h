@@ -0,0 +1,47 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "defines.h"
+#include "Arduino.h"
+
+/*
+	Binary trace of interrupt handler and task activity. Records (6 bytes: event id, payload byte,
+	now_us() timestamp) are written to a RAM ring, oldest records are overwritten. Ring is dumped
+	over serial with edcConf "_TRC" query.
+
+	Enabled with TRACE in defines.h, otherwise macros compile to nothing.
+*/
+
+#define TRACE_TIMER3 1
+#define TRACE_TIMER3_TASK 2 /* payload = interrupt handler slot */
+#define TRACE_ADC 3 /* all 16 channels converted */
+#define TRACE_RPM 4 /* payload at exit: 0 = mark, 1 = rejected edge, 2 = first mark after stop, 3 = tooth wheel sync lost */
+#define TRACE_RPM_STALL 5
+#define TRACE_CRANK_TASK 6 /* payload = task index */
+#define TRACE_LOOP_TASK 7 /* payload = task index */
+#define TRACE_NEEDLE 8 /* payload = cylinder phase slot */
+#define TRACE_EXIT 0x80 /* or'ed to id at exit */
+
+#define TRACE_BUFFER_SIZE 64 /* records, power of two */
+#define TRACE_RECORD_SIZE 6 /* bytes per record in dump, time is little endian */
+
+struct traceRecordStruct {
+	unsigned char id;
+	unsigned char payload;
+	unsigned long time;
+};
+
+#ifdef TRACE
+void traceWrite(unsigned char id,unsigned char payload);
+void traceDump(void (*send)(const unsigned char *data,unsigned char len));
+
+#define TRACE_ENTER(id,payload) traceWrite(id,payload)
+#define TRACE_LEAVE(id,payload) traceWrite((id)|TRACE_EXIT,payload)
+#define TRACE_EVENT(id,payload) traceWrite(id,payload)
+#else
+#define TRACE_ENTER(id,payload)
+#define TRACE_LEAVE(id,payload)
+#define TRACE_EVENT(id,payload)
+#endif
+
+#endif
@@ -0,0 +1,9 @@
+#include "UiSerial.h"
+
+UiSerial uiSerial;
+
+size_t UiSerial::write(uint8_t c) {
+	while (Serial.availableForWrite() == 0 && waitHook)
+		waitHook();
+	return Serial.write(c);
+}
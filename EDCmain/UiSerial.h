@@ -0,0 +1,21 @@
+#ifndef UISERIAL_H
+#define UISERIAL_H
+
+#include "Arduino.h"
+
+/*
+	Serial output of configuration UI and EDC Configurator stream. Serial.write() busy-waits when the
+	transmit buffer is full, a full page redraw (~2kB) would hold main loop for ~170ms at 115200 baud.
+	uiSerial calls waitHook instead while there is no room, main loop uses it to run control tasks.
+	Hook must not write to uiSerial.
+*/
+class UiSerial : public Print {
+public:
+	void (*waitHook)();
+	virtual size_t write(uint8_t c);
+	using Print::write;
+};
+
+extern UiSerial uiSerial;
+
+#endif
@@ -6,7 +6,7 @@
 
 #define NUMBER_OF_CYLINDERS 5
 #define NEEDLELIFTSENSOR_CYLINDER 3
-#define FIRING_ORDER {4,5,3,1,2} /* Starting on with cylinder where needle sensor is */
+#define FIRING_ORDER {4,5,3,1,2} /* Any rotation, cylinder phase is counted from NEEDLELIFTSENSOR_CYLINDER */
 //#define ATDC_MARK 115 /* Position of each cylinder's timing mark on flywheel/crankshaft, 115 = 11.5° after TDC. Time difference between needle lift sensor trigger and this mark is used to calculate timing */
 #define BTDC_MARK 605 /* Position of each cylinder's timing mark on flywheel/crankshaft, 60.5= 60.5° before TDC. Time difference between needle lift sensor trigger and this mark is used to calculate timing */
 #define FLYWHEEL_MARK_ANGLE (360 / NUMBER_OF_CYLINDERS)
@@ -33,11 +33,24 @@
 #define ENGINE_RPM_CRANKING_LIMIT   450
 
 
+//#define RPM_INPUT_CAPTURE /* crank sensor on ICP5 (pin 48) and timer5 for rpm counting, tacho output moves to timer1 (pin 12) */
+//#define RPM_SENSOR_TYPE_TOOTH_WHEEL /* crank sensor reads a toothed wheel (RPMToothWheel.h) instead of one mark per cylinder */
+#define RPM_TOOTH_WHEEL_TEETH 60 /* tooth positions, missing ones included */
+#define RPM_TOOTH_WHEEL_MISSING 2
+
 /* Trigger inputs (interrupt handlers) */
+#ifdef RPM_INPUT_CAPTURE
+#define PIN_INPUT_RPM 48 /* do not change! */ 
+#else
 #define PIN_INPUT_RPM 2 /* do not change! */ 
+#endif
 #define PIN_INPUT_NEEDLELIFTSENSOR 3 /* do not change! */ 
 
+#ifdef RPM_INPUT_CAPTURE
+/* Note: PIN 44 & PIN 46 cannot be used for PWM (timer5 is reserved for rpm counting) */
+#else
 /* Note: PIN 11 & PIN 12 cannot be used for PWM (timer1 is reserved for rpm counting) */
+#endif
 
 /* Analog Inputs */
 #define PIN_ANALOG_QA_POS A1
@@ -103,7 +116,11 @@
 #define PIN_RELAY_AUX 29
 
 /* general outputs */
+#ifdef RPM_INPUT_CAPTURE
+#define PIN_TACHO_OUT 12
+#else
 #define PIN_TACHO_OUT 45
+#endif
 #define PIN_GLOW_LIGHT 13
 #define PIN_RPM_PROBE 53
 
@@ -138,6 +155,26 @@
 #define MAP_AXIS_PWM8 0x12
 #define MAP_AXIS_HALF_SECONDS 0x13
 
+// 'W' format maps store cells as 16-bit words (little endian) in 10-bit output units
+#define MAP_WIDE_CELL_MAX 1023
+#define MAP_WORD(v) ((v)&0xff),((v)>>8)
+#define MAP_RAM_ARENA_SIZE 512 /* RAM for maps loaded from EEPROM or edited: edit copy + fuel, boost and idle maps. Map that does not fit stays at flash default (DTC 21) */
+
+//#define MAP_HEATMAP /* per cell hit counters of 2D maps (map tuning aid, costs a counter update per lookup and the arena), for tuning builds only */
+#define MAP_HEATMAP_ARENA_SIZE 264 /* one byte per cell, 2D maps are given counters in index order while space lasts */
+#define MAP_HEATMAP_PRESCALE 32 /* count every n:th lookup of a map, power of two */
+#define MAP_HEATMAP_DECAY_SECONDS 30 /* counters are halved periodically to weight recent operation, 0 = saturate only */
+
+#define CRANK_SYNC_FUEL /* above cranking speed fuel amount is calculated at a fixed crank angle instead of Timer3 tick, comment out to use timer only */
+#define CRANK_SYNC_FUEL_ANGLE 100 /* 10.0° after flywheel mark (mark is at BTDC_MARK) */
+#define FUEL_UPDATE_PERIOD_US 8000 /* Timer3 fuel update period (125Hz), also time base of nodeFuelMapSmoothness */
+
+#define MEMORY_MARGIN_MIN 256 /* bytes, DTC is set if free gap between heap and deepest stack gets smaller */
+
+//#define TRACE /* binary trace ring of interrupt handler and task entry/exit (Trace.h), for debugging builds only */
+
+//#define TASK_STATS /* execution time & start jitter statistics of ISR and loop tasks (TaskStats.h), for debugging builds only */
+
 
 #define BOOST_MAX_CLIP 1
 #define BOOST_MIN_CLIP 2
@@ -172,6 +209,8 @@
 #define EDCCONF_TEMP_COOLANT 10
 #define EDCCONF_TEMP_FUEL 11
 #define EDCCONF_TEMP_INTAKE 12
+#define EDCCONF_STACK_MARGIN 13
+#define EDCCONF_MAP_ARENA_USED 14
 
 #define EDCCONF_QA_PID_P 70
 #define EDCCONF_QA_PID_I 71
@@ -6,6 +6,7 @@
 #include "Core.h"
 #include "defines.h"
 #include "DTC.h"
+#include "UiSerial.h"
 
 // EEProm
 
@@ -43,20 +44,20 @@ void printValue(int i,char type) {
             break;*/
         case VALUE_PWM8:
             printIntWithPadding(map(i,0,255,0,100),5,' ');
-            Serial.print("%");            
+            uiSerial.print("%");            
             break;
         case VALUE_MS:
             printIntWithPadding(i,5,' ');
-            Serial.print("ms");        
+            uiSerial.print("ms");        
             break;            
         case VALUE_KPA:
             printIntWithPadding(toKpa(i),5,' ');
-            Serial.print("kPa");        
+            uiSerial.print("kPa");        
             break;
 
         case VALUE_CELSIUS:                   
             printIntWithPadding(toTemperature(i),5,' ');
-            Serial.print("C");                            
+            uiSerial.print("C");                            
             break;
 
 /*        case VALUE_DEGREE:
@@ -65,58 +66,58 @@ void printValue(int i,char type) {
 //            ltoa((BTDC_MARK+i),buf,10);
             ltoa((i),buf,10);
             for (unsigned char c=0;c<5-strlen(buf)-1;c++)
-                Serial.print(" ");
+                uiSerial.print(" ");
             for (unsigned char c=0;c<strlen(buf);c++) {
                 if (c == strlen(buf)-1) 
-                    Serial.print(".");
-                Serial.print(buf[c]);           
+                    uiSerial.print(".");
+                uiSerial.print(buf[c]);           
             }
-            Serial.print("°");                                        
+            uiSerial.print("°");                                        
             break;            
         case VALUE_VOLTAGE:
             fixed = ((unsigned int)i*48);   // ~4.97v
-            Serial.print(" ");            
+            uiSerial.print(" ");            
             ltoa(fixed,buf,10);
             if (strlen(buf) == 5) {
-                Serial.print(buf[0]);
-                Serial.print(".");
-                Serial.print(buf[1]);
-                Serial.print(buf[2]);
+                uiSerial.print(buf[0]);
+                uiSerial.print(".");
+                uiSerial.print(buf[1]);
+                uiSerial.print(buf[2]);
             } else if (strlen(buf) == 4) {
-                Serial.print("0.");
-                Serial.print(buf[0]);
-                Serial.print(buf[1]);
+                uiSerial.print("0.");
+                uiSerial.print(buf[0]);
+                uiSerial.print(buf[1]);
             }  else if (strlen(buf) == 3) {
-                Serial.print("0.0");
-                Serial.print(buf[0]);
+                uiSerial.print("0.0");
+                uiSerial.print(buf[0]);
             } else {
-                Serial.print("0.00");
+                uiSerial.print("0.00");
             }            
-            Serial.print("v");                
+            uiSerial.print("v");                
             break;
         case VALUE_BATTERY_VOLTAGE:
             fixed = (float)(2.45*(float)i); // r1= 3000, r2 = 10000
             ltoa(fixed,buf,10);
             if (strlen(buf) == 4) {
-                Serial.print(buf[0]);
-                Serial.print(buf[1]);
-                Serial.print(".");
-                Serial.print(buf[2]);
-                Serial.print(buf[3]);
+                uiSerial.print(buf[0]);
+                uiSerial.print(buf[1]);
+                uiSerial.print(".");
+                uiSerial.print(buf[2]);
+                uiSerial.print(buf[3]);
             } else
             if (strlen(buf) == 3) {
-                Serial.print(" ");
-                Serial.print(buf[0]);
-                Serial.print(".");
-                Serial.print(buf[1]);
-                Serial.print(buf[2]);
+                uiSerial.print(" ");
+                uiSerial.print(buf[0]);
+                uiSerial.print(".");
+                uiSerial.print(buf[1]);
+                uiSerial.print(buf[2]);
             } else if (strlen(buf) == 2) {
-                Serial.print(" 0.0");
-                Serial.print(buf[0]);
+                uiSerial.print(" 0.0");
+                uiSerial.print(buf[0]);
             } else {
-                Serial.print(" 0.00");
+                uiSerial.print(" 0.00");
             }            
-            Serial.print("v");                
+            uiSerial.print("v");                
             break;            
 /*
         case VALUE_FIXED_POINT_2:
@@ -124,20 +125,20 @@ void printValue(int i,char type) {
             break;*/
         case VALUE_BOOLEAN:
             if (i==0) {
-                Serial.print("  Off");
+                uiSerial.print("  Off");
             } else {
-                Serial.print("   On");                
+                uiSerial.print("   On");                
             }
             break;
         case VALUE_HEX:
             ltoa(i,buf,16);
             printStringWithPadding(buf,5,' ');            
-            Serial.print("h");
+            uiSerial.print("h");
             break;
         case VALUE_INT:
         default:
             printIntWithPadding(i,5,' ');
-            Serial.print("   ");            
+            uiSerial.print("   ");            
     }
 }
 
@@ -156,14 +157,14 @@ bool printFromFlash(const char *str) {
     if (flashFetchBuffer[0] == 0) {
         return false;
     }
-    Serial.print(flashFetchBuffer);
+    uiSerial.print(flashFetchBuffer);
     return true;
 }
 
 void printPads(unsigned char n, char padChar) {
     memset(flashFetchBuffer,padChar,n);
     flashFetchBuffer[n] = 0;
-    Serial.print(flashFetchBuffer);
+    uiSerial.print(flashFetchBuffer);
 }
 
 void printIntWithPadding(int val,unsigned char width,char padChar) {
@@ -172,7 +173,7 @@ void printIntWithPadding(int val,unsigned char width,char padChar) {
     // append string presentation of number to end
     itoa(val,flashFetchBuffer+30,10);
     // print string with given width
-    Serial.print(flashFetchBuffer+30+strlen(flashFetchBuffer+30)-width);
+    uiSerial.print(flashFetchBuffer+30+strlen(flashFetchBuffer+30)-width);
 }
 
 void printStringWithPadding(char *str,unsigned char width,char padChar) {
@@ -183,7 +184,7 @@ void printStringWithPadding(char *str,unsigned char width,char padChar) {
     strcpy(flashFetchBuffer+30, str);
     
     // print string with given width
-    Serial.print(flashFetchBuffer+30+strlen(flashFetchBuffer+30)-width);
+    uiSerial.print(flashFetchBuffer+30+strlen(flashFetchBuffer+30)-width);
 }
 
 // VT102/Ansi functions
@@ -195,11 +196,11 @@ const char ANSIClearEos[] PROGMEM = { 27,'[','J',0};
 const char ANSIHideCursor[] PROGMEM = { 27,'[','?','2','5','h',0}; // doesn't work?
 
 void ansiGotoXy(char x,char y) {
-  Serial.print("\e[");
-  Serial.print(y,DEC);
-  Serial.print(";");
-  Serial.print(x,DEC);
-  Serial.print("H");
+  uiSerial.print("\e[");
+  uiSerial.print(y,DEC);
+  uiSerial.print(";");
+  uiSerial.print(x,DEC);
+  uiSerial.print("H");
 }
 
 void ansiClearScreen() {
@@ -236,188 +237,350 @@ unsigned char mapValuesSqueeze(int raw,int mapMin,int mapMax) {
     return map(raw,0,255,mapMin,mapMax);
 }
 
-// Interpolate value between p1 and p1, given by pos (0-99)
-unsigned char mapInterpolate(unsigned char p1,unsigned char p2, unsigned char pos) {
-    return (p1*(100-pos)+p2*pos)/100;
+/*
+    Map lookup & interpolation
+
+    Lookups are done with multiplies and shifts only (AVR has no hardware divider). Per-axis
+    scale factors are calculated once by mapPrepare() when map is initialized or loaded, 
+    after that input value (0..255) is converted to 8.8 fixed point cell position:
+    
+        pos = (input * scale) >> 8     (high byte = cell index, low byte = fraction 0..255 towards next cell)
+
+    Breakpoints of 'D' maps are evenly distributed on 0..255 range, so last cell is always at input 255.
+
+    'B' maps carry explicit (increasing) breakpoints for both axes after the header. Cell is found by
+    stepping from the previously used cell, so steady state lookup costs one or two compares. 
+    Fraction is then calculated with reciprocal of breakpoint distance (mapReciprocal table).
+
+    'W' maps are like 'B' maps, but cells are 16-bit words holding the full 10-bit output value.
+    They have their own kernel (one widening multiply per interpolation step) and mapLookUp10bit() 
+    returns the interpolated cell value as is.
+
+    Default maps are in flash, lookups read them with LPM (one extra cycle per byte). Kernels are 
+    templates on the reader, flash/RAM is selected once per mapLocate()/mapRead() call.
+
+    Lookups only read map data. Operating point for the map editor is written to a separate 
+    mapTelemetryStruct record, and only when one is attached to the map (editor page is open).
+
+    Lookup is done in two steps, mapLocate() (input -> cell & fractions) and mapRead(). When several maps 
+    are read with the same input pair, mapLocate() is called once and mapRead() for each map. Maps with 
+    identical axes share axesId (see Core::groupMaps), mapRead() locates the cell again if ids differ. 
+*/
+
+#define MAP_RECIPROCAL(d) (65535u/((d)?(d):1))
+#define MAP_RECIPROCAL4(d) MAP_RECIPROCAL(d),MAP_RECIPROCAL(d+1),MAP_RECIPROCAL(d+2),MAP_RECIPROCAL(d+3)
+#define MAP_RECIPROCAL16(d) MAP_RECIPROCAL4(d),MAP_RECIPROCAL4(d+4),MAP_RECIPROCAL4(d+8),MAP_RECIPROCAL4(d+12)
+#define MAP_RECIPROCAL64(d) MAP_RECIPROCAL16(d),MAP_RECIPROCAL16(d+16),MAP_RECIPROCAL16(d+32),MAP_RECIPROCAL16(d+48)
+
+// 65535/distance, (distance-1)*reciprocal always fits in 16 bits
+static const unsigned int mapReciprocal[256] PROGMEM = {
+    MAP_RECIPROCAL64(0),MAP_RECIPROCAL64(64),MAP_RECIPROCAL64(128),MAP_RECIPROCAL64(192)
+};
+
+// Map data is read through a reader, default maps live in flash until they are loaded or edited (see Core::mapWritable)
+struct mapRamReader {
+    static inline unsigned char byte(const unsigned char *p) { return *p; }
+    static inline unsigned int word(const unsigned char *p) { return *(const uint16_t*)p; }
+};
+
+struct mapFlashReader {
+    static inline unsigned char byte(const unsigned char *p) { return pgm_read_byte(p); }
+    static inline unsigned int word(const unsigned char *p) { return pgm_read_word(p); }
+};
+
+// Reads byte from map data (header, breakpoints, cells) at given offset
+unsigned char mapDataByte(const mapInfoStruct *map,unsigned int ofs) {
+    return map->flash ? mapFlashReader::byte(map->data+ofs) : mapRamReader::byte(map->data+ofs);
+}
+
+// Storage size of map (header, axis breakpoints, cells and saved part of live view trailer)
+unsigned int mapDataSize(const mapInfoStruct *map) {
+    unsigned int size = map->cells-map->data; // header and breakpoints
+    size += map->sizeX*map->sizeY*(map->wide ? 2 : 1);
+    return size+MAP_TRAILER_SAVED;
+}
+
+// Size of map data in memory, see mapDataSize
+unsigned int mapBlobSize(const mapInfoStruct *map) {
+    return mapDataSize(map)-MAP_TRAILER_SAVED+MAP_TRAILER_SIZE;
 }
 
-// Interpolate value between p1 and p1 (range 0-255), given by pos (0-99)
-// returned value upscaled to 0-1023 range
+// flash = true if mapData is in PROGMEM
+void mapPrepare(mapInfoStruct *map,const unsigned char *mapData,bool flash) {
+    map->data = mapData;
+    map->flash = flash;
+    unsigned char format = mapDataByte(map,MAP_OFS_FORMAT);
+    map->telemetry = NULL;
+    map->sizeX = mapDataByte(map,MAP_OFS_SIZE_X);
+    map->sizeY = mapDataByte(map,MAP_OFS_SIZE_Y);
+    map->interpolated = (format == 'D' || format == 'B' || format == 'W');
+    map->wide = (format == 'W');
+    map->hintX = 0;
+    map->hintY = 0;
+    if (format == 'B' || format == 'W') {
+        map->axisX = mapData+MAP_HEADER_SIZE;
+        map->axisY = mapData+MAP_HEADER_SIZE+map->sizeX;
+        map->cells = mapData+MAP_HEADER_SIZE+map->sizeX+map->sizeY;
+    } else {
+        map->axisX = NULL;
+        map->axisY = NULL;
+        map->cells = mapData+MAP_HEADER_SIZE;
+    }
+    // scale = (size-1)*256/255 in 8.8 fixed point, rounded up so that input 255 hits exactly the last cell
+    map->scaleX = map->sizeX>1 ? (((unsigned long)(map->sizeX-1)<<16)+254)/255 : 0;
+    map->scaleY = map->sizeY>1 ? (((unsigned long)(map->sizeY-1)<<16)+254)/255 : 0;
+}
+
+// Interpolate value between p1 and p2, given by pos (0-255, 8bit fraction of the way from p1 to p2)
+// returned value is in 8.8 fixed point
+static inline unsigned int mapInterpolateFixed(unsigned char p1,unsigned char p2, unsigned char pos) {
+    // weights sum up to 256, max. result 255*256 fits in 16 bits 
+    return p1*(unsigned int)(256-pos)+p2*(unsigned int)pos;
+}
 
+// Interpolate value between p1 and p2, given by pos (0-255)
+unsigned char mapInterpolate(unsigned char p1,unsigned char p2, unsigned char pos) {
+    return (mapInterpolateFixed(p1,p2,pos)+128)>>8;
+}
+
+// Interpolate value between p1 and p2 (range 0-255), given by pos (0-255)
+// returned value upscaled to 0-1020 range
 unsigned int mapInterpolate10bit(unsigned char p1,unsigned char p2, unsigned char pos) {
-    pos=pos/2;
-    unsigned int pp1=p1*4;
-    unsigned int pp2=p2*4;
-    return (pp1*(50-pos)+pp2*pos)/50;
-}
-
-unsigned char mapLookUp(unsigned char *mapData,unsigned char x,unsigned char y) {
-    unsigned char isInterpolated = *(mapData+2+2);
-    unsigned char tableSizeX = *(mapData+3+2);
-    unsigned char tableSizeY = *(mapData+4+2);
-    unsigned char yPos;
-    int ofs = 10; // skip headers
-    unsigned char idxX;
-    unsigned char idxY;
-
-    *(mapData+ofs+tableSizeX*tableSizeY) = x;
-    *(mapData+ofs+tableSizeX*tableSizeY+1) = y;
-
-    if (tableSizeY) {
-        yPos = y / (256/(tableSizeY-1));
-    } 
-    else {
-        yPos = 0;
+    return (mapInterpolateFixed(p1,p2,pos)+32)>>6;
+}
+
+// Interpolate value between 16-bit cells p1 and p2, given by pos (0-255)
+static inline unsigned int mapInterpolateWide(unsigned int p1,unsigned int p2, unsigned char pos) {
+    if (p2 >= p1)
+        return p1+(((unsigned long)(p2-p1)*pos+128)>>8);
+    return p1-(((unsigned long)(p1-p2)*pos+128)>>8);
+}
+
+// Converts input value to cell index, fraction towards next cell is stored to *frac
+static inline unsigned char mapAxisPosition(unsigned int scale,unsigned char size,unsigned char value,unsigned char *frac) {
+    unsigned int pos = ((unsigned long)value*scale)>>8;
+    unsigned char idx = pos>>8;
+    if (idx >= size-1) {
+        *frac = 0;
+        return size-1;
     }
-    unsigned char xPos = (x / (256/(tableSizeX-1)));
-    
-    unsigned char p1 = *(mapData+ofs+(yPos*tableSizeX)+xPos);
-    unsigned char p2 = *(mapData+ofs+(yPos*tableSizeX)+(((xPos+1)>=tableSizeX)?xPos:xPos+1));
-    ;
-    unsigned char p3 = *(mapData+ofs+((((yPos+1)>=tableSizeX)?yPos:yPos+1)*tableSizeX)+xPos);
-    unsigned char p4 = *(mapData+ofs+((((yPos+1)>=tableSizeX)?yPos:yPos+1)*tableSizeX)+(((xPos+1)>=tableSizeX)?xPos:xPos+1));
-    
-    unsigned char ret;
-    if (isInterpolated == 'D') {
-        int amountX = (x % (256/(tableSizeX-1)))*(10000/(256/(tableSizeX-1)));
-        if (amountX<5000) {
-            idxX = 1+xPos;
-        } else {
-            idxX = 1+xPos+1;
-        }        
-        if (tableSizeY) {
-            // 2D
-            int amountY = (y % (256/(tableSizeY-1)))*(10000/(256/(tableSizeY-1)));
-            char y1 = mapInterpolate(p1,p2,amountX /100);
-            char y2 = mapInterpolate(p3,p4,amountX /100);
-            ret = mapInterpolate(y1,y2,amountY /100);
-            if (amountY<5000) {
-                idxY = 1+yPos;
-            } else {
-                idxY = 1+yPos+1;
-            }            
-        } 
-        else {
-            // 1D
-            ret = mapInterpolate(p1,p2,amountX /100);
-        }
-    } 
-    else {
-        ret = p1;
+    *frac = pos & 0xff;
+    return idx;
+}
+
+// Same as above for axis with explicit breakpoints, search is started from the previously used cell (*hint)
+template <class R>
+static inline unsigned char mapAxisSearch(const unsigned char *axis,unsigned char size,unsigned char *hint,unsigned char value,unsigned char *frac) {
+    unsigned char idx = *hint;
+    while (idx > 0 && value < R::byte(axis+idx))
+        idx--;
+    while (idx < size-1 && value >= R::byte(axis+idx+1))
+        idx++;
+    *hint = idx;
+    unsigned char low = R::byte(axis+idx);
+    if (idx >= size-1 || value <= low) {
+        // beyond last breakpoint, below first one or exactly on breakpoint
+        *frac = 0;
+        return idx;
+    }
+    unsigned char distance = R::byte(axis+idx+1) - low;
+    *frac = ((unsigned char)(value - low)*pgm_read_word(&mapReciprocal[distance]))>>8;
+    return idx;
+}
+
+template <class R>
+static void mapLocateData(const mapInfoStruct *map,unsigned char x,unsigned char y,mapCellStruct *cell) {
+    unsigned char sizeX = map->sizeX;
+    unsigned char sizeY = map->sizeY;
+
+    cell->axesId = map->axesId;
+    cell->x = x;
+    cell->y = y;
+    cell->yPos = 0;
+    cell->fracY = 0;
+    if (map->axisX) {
+        cell->xPos = mapAxisSearch<R>(map->axisX,sizeX,&map->hintX,x,&cell->fracX);
+        if (sizeY>1)
+            cell->yPos = mapAxisSearch<R>(map->axisY,sizeY,&map->hintY,y,&cell->fracY);
+    } else {
+        cell->xPos = mapAxisPosition(map->scaleX,sizeX,x,&cell->fracX);
+        if (sizeY>1)
+            cell->yPos = mapAxisPosition(map->scaleY,sizeY,y,&cell->fracY);
+    }
+}
+
+// Finds cell position for input pair, result is valid for all maps with same axesId
+void mapLocate(const mapInfoStruct *map,unsigned char x,unsigned char y,mapCellStruct *cell) {
+    if (map->flash)
+        mapLocateData<mapFlashReader>(map,x,y,cell);
+    else
+        mapLocateData<mapRamReader>(map,x,y,cell);
+}
+
+// Live view for map editor and hit counting, ret is 8.8 fixed point (or cell value for 'W' maps)
+static inline void mapRecordOperatingPoint(const mapInfoStruct *map,const mapCellStruct *cell,unsigned char fracX,unsigned char fracY,unsigned int ret) {
+    mapTelemetryStruct *telemetry = map->telemetry;
+    if (telemetry) {
+        telemetry->lastX = cell->x;
+        telemetry->lastY = cell->y;
+        telemetry->lastRet = ret;
+        telemetry->idxX = 1+cell->xPos+(fracX>=128);
+        telemetry->idxY = 1+cell->yPos+(fracY>=128);
+    }
+#ifdef MAP_HEATMAP
+    // nearest cell, every MAP_HEATMAP_PRESCALE:th lookup. ~10 cycles when skipped, ~25 when counted
+    unsigned char *heat = map->heat;
+    if (heat && (++map->heatTick & (MAP_HEATMAP_PRESCALE-1)) == 0) {
+        heat += (unsigned char)(cell->yPos+(fracY>=128))*map->sizeX+cell->xPos+(fracX>=128);
+        if (*heat != 0xff)
+            (*heat)++;
+    }
+#endif
+}
+
+// Returns interpolated value of 'W' map
+template <class R>
+static unsigned int mapReadWide(const mapInfoStruct *map,const mapCellStruct *cell) {
+    unsigned char sizeX = map->sizeX;
+    unsigned char fracX = cell->fracX;
+    unsigned char fracY = cell->fracY;
+
+    const unsigned char *p = map->cells+((cell->yPos*sizeX+cell->xPos)<<1);
+    unsigned int ret = fracX ? mapInterpolateWide(R::word(p),R::word(p+2),fracX) : R::word(p);
+    if (fracY) {
+        p += sizeX<<1;
+        unsigned int ret2 = fracX ? mapInterpolateWide(R::word(p),R::word(p+2),fracX) : R::word(p);
+        ret = mapInterpolateWide(ret,ret2,fracY);
     }
-    *(mapData+ofs+tableSizeX*tableSizeY+2) = ret;
-    *(mapData+ofs+tableSizeX*tableSizeY+5) = idxX;
-    *(mapData+ofs+tableSizeX*tableSizeY+6) = idxY;    
 
+    mapRecordOperatingPoint(map,cell,fracX,fracY,ret);
     return ret;
 }
 
-unsigned int mapLookUp10bit(unsigned char *mapData,unsigned char x,unsigned char y) {
-    unsigned char isInterpolated = *(mapData+2+2);
-    unsigned char tableSizeX = *(mapData+3+2);
-    unsigned char tableSizeY = *(mapData+4+2);
-    unsigned char yPos;
-    int ofs = 10; // skip headers
-    unsigned char idxX;
-    unsigned char idxY;
+// Returns interpolated map value in 8.8 fixed point
+template <class R>
+static unsigned int mapReadFixed(const mapInfoStruct *map,const mapCellStruct *cell) {
+    unsigned char sizeX = map->sizeX;
+    unsigned char fracX = cell->fracX;
+    unsigned char fracY = cell->fracY;
 
-    *(mapData+ofs+tableSizeX*tableSizeY) = x;
-    *(mapData+ofs+tableSizeX*tableSizeY+1) = y;
-    
-    if (tableSizeY) {
-        yPos = y / (256/(tableSizeY-1));
-    } 
-    else {
-        yPos = 0;
+    if (!map->interpolated) {
+        fracX = 0;
+        fracY = 0;
     }
-    unsigned char xPos = (x / (256/(tableSizeX-1)));
-    
-    unsigned char p1 = *(mapData+ofs+(yPos*tableSizeX)+xPos);
-    unsigned char p2 = *(mapData+ofs+(yPos*tableSizeX)+(((xPos+1)>=tableSizeX)?xPos:xPos+1));
-    ;
-    unsigned char p3 = *(mapData+ofs+((((yPos+1)>=tableSizeX)?yPos:yPos+1)*tableSizeX)+xPos);
-    unsigned char p4 = *(mapData+ofs+((((yPos+1)>=tableSizeX)?yPos:yPos+1)*tableSizeX)+(((xPos+1)>=tableSizeX)?xPos:xPos+1));
-    
-    unsigned int ret;
-    if (isInterpolated == 'D') {
-        int amountX = (x % (256/(tableSizeX-1)))*(10000/(256/(tableSizeX-1)));
-        if (amountX<50) {
-            idxX = 1+xPos;
-        } else {
-            idxX = 1+xPos+1;
-        }
-        if (tableSizeY) {
-            // 2D
-            int amountY = (y % (256/(tableSizeY-1)))*(10000/(256/(tableSizeY-1)));
-            char y1 = mapInterpolate(p1,p2,amountX /100);
-            char y2 = mapInterpolate(p3,p4,amountX /100);
-            ret = mapInterpolate10bit(y1,y2,amountY /100);
-            if (amountY<50) {
-                idxY = 1+yPos;
-            } else {
-                idxY = 1+yPos+1;
-            }
-        } 
-        else {
-            // 1D
-            ret = mapInterpolate10bit(p1,p2,amountX /100);
-        }
-    } 
-    else {
-        ret = p1*4;
+
+    // fraction is always zero on last row/column, so neighbour cells are read only when they exist
+    const unsigned char *p = map->cells+cell->yPos*sizeX+cell->xPos;
+    unsigned int ret = fracX ? mapInterpolateFixed(R::byte(p),R::byte(p+1),fracX) : R::byte(p)<<8;
+    if (fracY) {
+        p += sizeX;
+        unsigned int ret2 = fracX ? mapInterpolateFixed(R::byte(p),R::byte(p+1),fracX) : R::byte(p)<<8;
+        ret = ((unsigned long)ret*(unsigned int)(256-fracY)+(unsigned long)ret2*fracY)>>8;
     }
-    *(mapData+ofs+tableSizeX*tableSizeY+2) = ret/4;
-    *(unsigned int*)(mapData+ofs+tableSizeX*tableSizeY+3) = ret;
-    *(mapData+ofs+tableSizeX*tableSizeY+5) = idxX;
-    *(mapData+ofs+tableSizeX*tableSizeY+6) = idxY; 
+
+    mapRecordOperatingPoint(map,cell,fracX,fracY,ret);
     return ret;
 }
 
+unsigned char mapRead(const mapInfoStruct *map,const mapCellStruct *cell) {
+    mapCellStruct own;
+    if (cell->axesId != map->axesId) {
+        // axes differ from the ones cell was located for
+        mapLocate(map,cell->x,cell->y,&own);
+        cell = &own;
+    }
+    if (map->wide) {
+        unsigned int ret = map->flash ? mapReadWide<mapFlashReader>(map,cell) : mapReadWide<mapRamReader>(map,cell);
+        // rounded ret/4 without overflowing 16 bits
+        ret = (ret>>2)+((ret>>1)&1);
+        return ret>255 ? 255 : ret;
+    }
+    return ((map->flash ? mapReadFixed<mapFlashReader>(map,cell) : mapReadFixed<mapRamReader>(map,cell))+128)>>8;
+}
+
+unsigned int mapRead10bit(const mapInfoStruct *map,const mapCellStruct *cell) {
+    mapCellStruct own;
+    if (cell->axesId != map->axesId) {
+        mapLocate(map,cell->x,cell->y,&own);
+        cell = &own;
+    }
+    if (map->wide)
+        return map->flash ? mapReadWide<mapFlashReader>(map,cell) : mapReadWide<mapRamReader>(map,cell);
+    return ((map->flash ? mapReadFixed<mapFlashReader>(map,cell) : mapReadFixed<mapRamReader>(map,cell))+32)>>6;
+}
+
+unsigned char mapLookUp(const mapInfoStruct *map,unsigned char x,unsigned char y) {
+    mapCellStruct cell;
+    mapLocate(map,x,y,&cell);
+    return mapRead(map,&cell);
+}
+
+unsigned int mapLookUp10bit(const mapInfoStruct *map,unsigned char x,unsigned char y) {
+    mapCellStruct cell;
+    mapLocate(map,x,y,&cell);
+    return mapRead10bit(map,&cell);
+}
+
+// True if maps have identical axes (size, breakpoints), so cell located for one is valid for the other
+bool mapSharesAxes(const mapInfoStruct *a,const mapInfoStruct *b) {
+    if (a->sizeX != b->sizeX || a->sizeY != b->sizeY)
+        return false;
+    if (!a->axisX || !b->axisX)
+        return !a->axisX && !b->axisX;
+    unsigned char axisSize = a->sizeY>1 ? a->sizeX+a->sizeY : a->sizeX;
+    for (unsigned char i=0;i<axisSize;i++) {
+        // axisY follows axisX
+        if (mapDataByte(a,MAP_HEADER_SIZE+i) != mapDataByte(b,MAP_HEADER_SIZE+i))
+            return false;
+    }
+    return true;
+}
+
 void printMapAxis(unsigned char axisType,unsigned char value,bool verbose) {
     switch (axisType) {
         case MAP_AXIS_NONE:
             break;
         case MAP_AXIS_RPM:
-            Serial.print(toRpm(value),DEC);
-            if (verbose) Serial.print(" Rpm");
+            uiSerial.print(toRpm(value),DEC);
+            if (verbose) uiSerial.print(" Rpm");
             break;
         case MAP_AXIS_IDLERPM:
-            Serial.print(value*4,DEC);
-            if (verbose) Serial.print(" Rpm");
+            uiSerial.print(value*4,DEC);
+            if (verbose) uiSerial.print(" Rpm");
             break;            
         case MAP_AXIS_TPS:
-            Serial.print(toTps(value),DEC);
-            if (verbose) Serial.print("% TPS");
+            uiSerial.print(toTps(value),DEC);
+            if (verbose) uiSerial.print("% TPS");
             break;
         case MAP_AXIS_KPA:
-            Serial.print(toKpa(value),DEC);
-            if (verbose) Serial.print(" kPa");
+            uiSerial.print(toKpa(value),DEC);
+            if (verbose) uiSerial.print(" kPa");
             break;
         case MAP_AXIS_VOLTAGE:
-            //Serial.print(toVoltage(value),DEC);
-            //if (verbose) Serial.print(" mV");
+            //uiSerial.print(toVoltage(value),DEC);
+            //if (verbose) uiSerial.print(" mV");
             printValue(value*4,VALUE_VOLTAGE);
             break;
         case MAP_AXIS_CELSIUS:
-            Serial.print(toTemperature(value),DEC);
-            if (verbose) Serial.print(" °C");
+            uiSerial.print(toTemperature(value),DEC);
+            if (verbose) uiSerial.print(" °C");
             break;
         case MAP_AXIS_INJECTION_TIMING:
-            //Serial.print(toVoltage(value),DEC);
-            //if (verbose) Serial.print(" mV");
+            //uiSerial.print(toVoltage(value),DEC);
+            //if (verbose) uiSerial.print(" mV");
             printValue(value*4,VALUE_INJECTION_TIMING);
             break;   
          case MAP_AXIS_INJECTED_FUEL:
-            Serial.print(value,DEC);
-            if (verbose) Serial.print(" IQ");
+            uiSerial.print(value,DEC);
+            if (verbose) uiSerial.print(" IQ");
             break;
          case MAP_AXIS_FUEL_TRIM_AMOUNT:
-            Serial.print((int)value-128,DEC);
-            if (verbose) Serial.print(" Ftrim");
+            uiSerial.print((int)value-128,DEC);
+            if (verbose) uiSerial.print(" Ftrim");
             break;                         
         default:
-            Serial.print(value);
-            if (verbose) Serial.print(" Raw");
+            uiSerial.print(value);
+            if (verbose) uiSerial.print(" Raw");
     }
 }
 
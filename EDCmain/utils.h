@@ -32,10 +32,21 @@ void ansiClearEos();
 
 unsigned char mapValues(int raw,int mapMin,int mapMax);
 
+struct mapInfoStruct;
+struct mapCellStruct;
+
+unsigned char mapDataByte(const mapInfoStruct *map,unsigned int ofs);
+unsigned int mapDataSize(const mapInfoStruct *map);
+unsigned int mapBlobSize(const mapInfoStruct *map);
+void mapPrepare(mapInfoStruct *map,const unsigned char *mapData,bool flash);
 unsigned int mapInterpolate10bit(unsigned char p1,unsigned char p2, unsigned char pos);
 unsigned char mapInterpolate(unsigned char p1,unsigned char p2, unsigned char pos);
-unsigned char mapLookUp(unsigned char *mapData,unsigned char x,unsigned char y);
-unsigned int mapLookUp10bit(unsigned char *mapData,unsigned char x,unsigned char y);
+unsigned char mapLookUp(const mapInfoStruct *map,unsigned char x,unsigned char y);
+unsigned int mapLookUp10bit(const mapInfoStruct *map,unsigned char x,unsigned char y);
+void mapLocate(const mapInfoStruct *map,unsigned char x,unsigned char y,mapCellStruct *cell);
+unsigned char mapRead(const mapInfoStruct *map,const mapCellStruct *cell);
+unsigned int mapRead10bit(const mapInfoStruct *map,const mapCellStruct *cell);
+bool mapSharesAxes(const mapInfoStruct *a,const mapInfoStruct *b);
 
 void printMapAxis(unsigned char axisType,unsigned char mapIdx,bool verbose);
 
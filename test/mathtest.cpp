@@ -0,0 +1,259 @@
+// Host test and benchmark of map lookup & conversion math (EDCmain/utils.cpp, RPMBase.cpp)
+//
+// Every function is compared against a double precision reference over all of its inputs (all 8-bit
+// inputs and input pairs, all 10-bit ADC values, all tick counts) and timed. Max. error is checked
+// against a limit, exit status is non-zero if any limit is exceeded. Timings are host nanoseconds,
+// useful only for comparing implementations.
+
+#include <stdio.h>
+#include <math.h>
+#include <time.h>
+#include "Arduino.h"
+#include "Core.h"
+#include "utils.h"
+#include "defines.h"
+#include "RPMBase.h"
+#include "RPMDefaultCPS.h"
+
+static volatile unsigned int sink; // keeps benchmarked calls from being optimized away
+static int failures;
+
+typedef Map<6,6,MAP_AXIS_RAW,MAP_AXIS_RAW,MAP_AXIS_RAW,'D'> testMapD;
+typedef Map<8,6,MAP_AXIS_RAW,MAP_AXIS_RAW,MAP_AXIS_RAW,'B'> testMapB;
+typedef Map<8,6,MAP_AXIS_RAW,MAP_AXIS_RAW,MAP_AXIS_RAW,'W'> testMapW;
+
+static double nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return ts.tv_sec*1e9+ts.tv_nsec;
+}
+
+static void report(const char *name,double maxError,double limit,double ns) {
+    bool ok = maxError <= limit;
+    printf("%-32s max.err %8.4f (limit %6.3f) %7.1f ns %s\n",name,maxError,limit,ns,ok ? "ok" : "FAIL");
+    if (!ok)
+        failures++;
+}
+
+// Fills test map with cell pattern (pattern 0) or full swing between neighbours (pattern 1),
+// breakpoints (if any) are same as in default fuel map
+static void prepareMap(mapInfoStruct *map,unsigned char *data,unsigned char pattern) {
+    static const unsigned char axisX[8] = {0,36,73,109,146,182,219,255};
+    static const unsigned char axisY[6] = {0,51,102,153,204,255};
+    memset(map,0,sizeof(mapInfoStruct));
+    mapPrepare(map,data,false);
+    if (map->axisX) {
+        memcpy((unsigned char*)map->axisX,axisX,map->sizeX);
+        memcpy((unsigned char*)map->axisY,axisY,map->sizeY);
+    }
+    unsigned char *cells = (unsigned char*)map->cells;
+    for (unsigned char i=0;i<map->sizeX*map->sizeY;i++) {
+        bool high = (i+i/map->sizeX)&1;
+        if (map->wide)
+            *((uint16_t*)cells+i) = pattern ? (high ? MAP_WIDE_CELL_MAX : 0) : (i*293u+101u)%(MAP_WIDE_CELL_MAX+1);
+        else
+            *(cells+i) = pattern ? (high ? 255 : 0) : i*73+29;
+    }
+}
+
+// Reference cell position (index + fraction) of input value on map axis
+static double axisPosition(const unsigned char *axis,unsigned char size,unsigned char value) {
+    if (!axis)
+        return value*(size-1)/255.0;
+    if (value <= axis[0])
+        return 0;
+    for (unsigned char i=0;i<size-1;i++) {
+        if (value < axis[i+1])
+            return i+(value-axis[i])/(double)(axis[i+1]-axis[i]);
+    }
+    return size-1;
+}
+
+static double cellValue(const mapInfoStruct *map,unsigned char x,unsigned char y) {
+    unsigned char idx = x+y*map->sizeX;
+    if (map->wide)
+        return *((const uint16_t*)map->cells+idx);
+    return *(map->cells+idx);
+}
+
+// Reference bilinear interpolation, result in cell units
+static double mapReference(const mapInfoStruct *map,unsigned char x,unsigned char y) {
+    double posX = axisPosition(map->axisX,map->sizeX,x);
+    double posY = map->sizeY>1 ? axisPosition(map->axisY,map->sizeY,y) : 0;
+    unsigned char x1 = posX,y1 = posY;
+    unsigned char x2 = x1<map->sizeX-1 ? x1+1 : x1;
+    unsigned char y2 = y1<map->sizeY-1 ? y1+1 : y1;
+    double fx = posX-x1,fy = posY-y1;
+    double top = cellValue(map,x1,y1)*(1-fx)+cellValue(map,x2,y1)*fx;
+    double bottom = cellValue(map,x1,y2)*(1-fx)+cellValue(map,x2,y2)*fx;
+    return top*(1-fy)+bottom*fy;
+}
+
+// All input pairs. Error comes from 8-bit fraction of cell position (1/256 of neighbour difference
+// on both axes) and output rounding, breakpoint axes add rounding of the reciprocal table
+static void testMap(const char *name8,const char *name10,const mapInfoStruct *map,double limit8,double limit10) {
+    double err8 = 0,err10 = 0;
+    double unit8 = map->wide ? 0.25 : 1; // reference -> 8-bit output
+    double unit10 = map->wide ? 1 : 4;
+    for (unsigned int y=0;y<256;y++) {
+        for (unsigned int x=0;x<256;x++) {
+            double ref = mapReference(map,x,y);
+            err8 = fmax(err8,fabs(mapLookUp(map,x,y)-ref*unit8));
+            err10 = fmax(err10,fabs(mapLookUp10bit(map,x,y)-ref*unit10));
+        }
+    }
+    double start = nowNs();
+    for (unsigned int y=0;y<256;y++)
+        for (unsigned int x=0;x<256;x++)
+            sink = mapLookUp(map,x,y);
+    report(name8,err8,limit8,(nowNs()-start)/65536);
+    start = nowNs();
+    for (unsigned int y=0;y<256;y++)
+        for (unsigned int x=0;x<256;x++)
+            sink = mapLookUp10bit(map,x,y);
+    report(name10,err10,limit10,(nowNs()-start)/65536);
+}
+
+static void testInterpolate() {
+    // all p1, p2 and pos values. Reference is exact in 8.8 fixed point
+    double err8 = 0,err10 = 0;
+    for (unsigned int p1=0;p1<256;p1++) {
+        for (unsigned int p2=0;p2<256;p2++) {
+            for (unsigned int pos=0;pos<256;pos++) {
+                double ref = (p1*(256.0-pos)+p2*(double)pos)/256;
+                err8 = fmax(err8,fabs(mapInterpolate(p1,p2,pos)-ref));
+                err10 = fmax(err10,fabs(mapInterpolate10bit(p1,p2,pos)-ref*4));
+            }
+        }
+    }
+    double start = nowNs();
+    for (unsigned int p1=0;p1<256;p1++)
+        for (unsigned int p2=0;p2<256;p2++)
+            for (unsigned int pos=0;pos<256;pos++)
+                sink = mapInterpolate(p1,p2,pos);
+    report("mapInterpolate",err8,0.5,(nowNs()-start)/(1<<24));
+    start = nowNs();
+    for (unsigned int p1=0;p1<256;p1++)
+        for (unsigned int p2=0;p2<256;p2++)
+            for (unsigned int pos=0;pos<256;pos++)
+                sink = mapInterpolate10bit(p1,p2,pos);
+    report("mapInterpolate10bit",err10,0.5,(nowNs()-start)/(1<<24));
+}
+
+static void testMaps() {
+    for (unsigned char pattern=0;pattern<2;pattern++) {
+        mapInfoStruct map;
+        unsigned char dataD[testMapD::size] = {MAP_HEADER(0,testMapD)};
+        prepareMap(&map,dataD,pattern);
+        testMap(pattern ? "mapLookUp 'D' 6x6 swing" : "mapLookUp 'D' 6x6",
+            pattern ? "mapLookUp10bit 'D' 6x6 swing" : "mapLookUp10bit 'D' 6x6",&map,1.5,5);
+        unsigned char dataB[testMapB::size] = {MAP_HEADER(0,testMapB)};
+        prepareMap(&map,dataB,pattern);
+        testMap(pattern ? "mapLookUp 'B' 8x6 swing" : "mapLookUp 'B' 8x6",
+            pattern ? "mapLookUp10bit 'B' 8x6 swing" : "mapLookUp10bit 'B' 8x6",&map,2.5,8);
+        unsigned char dataW[testMapW::size] = {MAP_HEADER(0,testMapW)};
+        prepareMap(&map,dataW,pattern);
+        testMap(pattern ? "mapLookUp 'W' 8x6 swing" : "mapLookUp 'W' 8x6",
+            pattern ? "mapLookUp10bit 'W' 8x6 swing" : "mapLookUp10bit 'W' 8x6",&map,2.5,8);
+    }
+
+    // 8-bit result of wide map saturates, also beyond MAP_WIDE_CELL_MAX
+    static const unsigned int wideCells[] = {MAP_WIDE_CELL_MAX,0xfffe,0xffff};
+    for (unsigned char i=0;i<3;i++) {
+        mapInfoStruct map;
+        unsigned char dataW[testMapW::size] = {MAP_HEADER(0,testMapW)};
+        prepareMap(&map,dataW,0);
+        for (unsigned char c=0;c<map.sizeX*map.sizeY;c++)
+            *((uint16_t*)map.cells+c) = wideCells[i];
+        double err = 0;
+        for (unsigned int y=0;y<256;y++)
+            for (unsigned int x=0;x<256;x++)
+                err = fmax(err,fabs(mapLookUp(&map,x,y)-255.0));
+        char name[40];
+        snprintf(name,sizeof(name),"mapLookUp 'W' cells 0x%04x",wideCells[i]);
+        report(name,err,0,0);
+    }
+}
+
+static void testMapValues() {
+    // 10-bit input scaled with current RPM scale and idle RPM scale
+    int scales[2] = {core.node[Core::nodeControlMapScaleRPM].value,1024};
+    for (unsigned char s=0;s<2;s++) {
+        double err = 0;
+        for (int raw=0;raw<1024;raw++) {
+            double ref = fmin(raw*255.0/scales[s],255);
+            err = fmax(err,fabs(mapValues(raw,0,scales[s])-ref));
+        }
+        double start = nowNs();
+        for (int raw=0;raw<1024;raw++)
+            sink = mapValues(raw,0,scales[s]);
+        report(s ? "mapValues (0..1024)" : "mapValues (0..RPM scale)",err,1,(nowNs()-start)/1024);
+    }
+}
+
+static void testConversions() {
+    // all 8-bit inputs, results are truncated
+    double err = 0;
+    for (int raw=0;raw<256;raw++)
+        err = fmax(err,fabs(toKpa(raw)-core.node[Core::nodeMAPkPa].value*raw/255.0));
+    double start = nowNs();
+    for (int raw=0;raw<256;raw++)
+        sink = toKpa(raw);
+    report("toKpa",err,1,(nowNs()-start)/256);
+
+    err = 0;
+    for (int raw=0;raw<256;raw++)
+        err = fmax(err,fabs(toRpm(raw)-core.node[Core::nodeControlMapScaleRPM].value*raw/255.0));
+    start = nowNs();
+    for (int raw=0;raw<256;raw++)
+        sink = toRpm(raw);
+    report("toRpm",err,1,(nowNs()-start)/256);
+
+    // temperature, all 10-bit ADC values of a connected sensor. Reference is Steinhart-Hart (B parameter)
+    // without the integer truncation of the result
+    int b = core.node[Core::nodeEngineTempSensorBcoefficient].value;
+    int r = core.node[Core::nodeEngineTempSensorNResistance].value;
+    int t = core.node[Core::nodeEngineTempSensorNTemp].value;
+    err = 0;
+    for (int raw=1;raw<1023;raw++) {
+        double resistance = TEMP_SENSOR_SERIES_RESITOR/(1023.0/raw-1.0);
+        double celsius = 1.0/(log(resistance/r)/b+1.0/(t+273.15))-273.15;
+        celsius = fmax(-35,fmin(156,celsius));
+        err = fmax(err,fabs(tempSensorBcoefficientCalc(raw,b,r,t)-(celsius+35)*4/3));
+    }
+    start = nowNs();
+    for (int raw=1;raw<1023;raw++)
+        sink = tempSensorBcoefficientCalc(raw,b,r,t);
+    report("tempSensorBcoefficientCalc",err,1,(nowNs()-start)/1022);
+}
+
+static void testRpm() {
+    // single mark and one revolution, all tick counts over measurable range
+    for (unsigned char marks=1;marks<=NUMBER_OF_CYLINDERS;marks+=NUMBER_OF_CYLINDERS-1) {
+        double err = 0;
+        unsigned long calls = 0;
+        for (unsigned long ticks=(unsigned long)RPMTIMER_MIN_DURATON*marks;ticks<65536ul*marks;ticks++) {
+            double ref = (double)RPMTIMER_TICKS_PER_MINUTE/NUMBER_OF_CYLINDERS*marks/ticks;
+            err = fmax(err,fabs(rpmFromTicks(ticks,marks)-ref));
+            calls++;
+        }
+        double start = nowNs();
+        for (unsigned long ticks=(unsigned long)RPMTIMER_MIN_DURATON*marks;ticks<65536ul*marks;ticks++)
+            sink = rpmFromTicks(ticks,marks);
+        report(marks==1 ? "rpmFromTicks (1 mark)" : "rpmFromTicks (1 revolution)",err,1,(nowNs()-start)/calls);
+    }
+}
+
+int main() {
+    testInterpolate();
+    testMaps();
+    testMapValues();
+    testConversions();
+    testRpm();
+    if (failures) {
+        printf("%d check(s) failed\n",failures);
+        return 1;
+    }
+    printf("all checks passed\n");
+    return 0;
+}
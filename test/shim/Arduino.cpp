@@ -0,0 +1,23 @@
+#include "Arduino.h"
+#include "EEPROM.h"
+
+SerialShim Serial;
+EEPROMShim EEPROM;
+volatile uint8_t SREG;
+
+unsigned long millis() {
+    return 0;
+}
+
+unsigned long micros() {
+    return 0;
+}
+
+// Same integer arithmetic as Arduino core
+long map(long x,long inMin,long inMax,long outMin,long outMax) {
+    return (x-inMin)*(outMax-outMin)/(inMax-inMin)+outMin;
+}
+
+int analogRead(uint8_t) {
+    return 0;
+}
@@ -0,0 +1,59 @@
+// Minimal Arduino API for building EDCmain sources on host (see Makefile)
+#ifndef ARDUINO_SHIM_H
+#define ARDUINO_SHIM_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+#include "avr/pgmspace.h"
+#include "avr/io.h"
+#include "avr/interrupt.h"
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define F_CPU 16000000UL
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define DEC 10
+#define HEX 16
+
+#define min(a,b) ((a)<(b)?(a):(b))
+#define max(a,b) ((a)>(b)?(a):(b))
+
+unsigned long millis();
+unsigned long micros();
+long map(long x,long inMin,long inMax,long outMin,long outMax);
+int analogRead(uint8_t pin);
+
+static inline char *itoa(int v,char *buf,int) { sprintf(buf,"%d",v); return buf; }
+static inline char *ltoa(long v,char *buf,int) { sprintf(buf,"%ld",v); return buf; }
+
+// Output is discarded
+class Print {
+public:
+    virtual size_t write(uint8_t) = 0;
+    size_t write(const uint8_t *,size_t size) { return size; }
+    size_t print(const char *) { return 0; }
+    size_t print(char) { return 0; }
+    size_t print(int,int = DEC) { return 0; }
+    size_t print(unsigned int,int = DEC) { return 0; }
+    size_t print(long,int = DEC) { return 0; }
+    size_t print(unsigned long,int = DEC) { return 0; }
+    size_t print(double,int = 2) { return 0; }
+    size_t println(const char * = "") { return 0; }
+    size_t println(int,int = DEC) { return 0; }
+};
+
+struct SerialShim : public Print {
+    size_t write(uint8_t) { return 1; }
+    int availableForWrite() { return 63; }
+};
+extern SerialShim Serial;
+
+#endif
@@ -0,0 +1,13 @@
+// 4kB EEPROM in RAM, starts erased
+#ifndef EEPROM_h
+#define EEPROM_h
+
+struct EEPROMShim {
+    unsigned char data[4096];
+    EEPROMShim() { memset(data,0xff,sizeof(data)); }
+    unsigned char read(int ofs) { return data[ofs]; }
+    void write(int ofs,unsigned char v) { data[ofs] = v; }
+};
+extern EEPROMShim EEPROM;
+
+#endif
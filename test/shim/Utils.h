@@ -0,0 +1,2 @@
+// Sources include these with varying case
+#include "utils.h"
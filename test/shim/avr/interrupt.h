@@ -0,0 +1,8 @@
+#ifndef INTERRUPT_SHIM_H
+#define INTERRUPT_SHIM_H
+
+#define ISR(vector,...) extern "C" void vector(void)
+static inline void cli() {}
+static inline void sei() {}
+
+#endif
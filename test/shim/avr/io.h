@@ -0,0 +1,8 @@
+#ifndef IO_SHIM_H
+#define IO_SHIM_H
+
+#include <stdint.h>
+
+extern volatile uint8_t SREG;
+
+#endif
@@ -0,0 +1,16 @@
+// Flash is ordinary memory on host
+#ifndef PGMSPACE_SHIM_H
+#define PGMSPACE_SHIM_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define PROGMEM
+#define PGM_P const char *
+#define PSTR(s) (s)
+#define strcpy_P strcpy
+#define memcpy_P memcpy
+#define pgm_read_byte(a) (*(const uint8_t*)(a))
+#define pgm_read_word(a) (*(const uint16_t*)(a))
+
+#endif
@@ -0,0 +1,27 @@
+// Firmware objects referenced by the sources under test, not exercised by the tests
+#include "DTC.h"
+#include "ConfEditor.h"
+#include "RPMBase.h"
+
+DTC dtc;
+ConfEditor confeditor;
+
+DTC::DTC() {
+}
+
+void DTC::setError(unsigned int) {
+}
+
+ConfEditor::ConfEditor() {
+}
+
+void ConfEditor::setSystemStatusMessage(const char *) {
+}
+
+unsigned int RPMBase::getLatestMeasureFiltered() {
+    return 0;
+}
+
+unsigned int RPMBase::getDeviationForCylinder(unsigned char) {
+    return 0;
+}